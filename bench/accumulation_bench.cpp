@@ -0,0 +1,53 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "model.hpp"
+#include "bench_common.hpp"
+
+// Memory against throughput of gradient accumulation: one logical batch
+// split into 1, 2, 4, ... micro-batches. Every row makes the same updates;
+// only the workspace (activations and gradients) and the speed change.
+
+int main(int argc, char** argv) {
+    unsigned int batch_size = argc > 1 ? std::stoul(argv[1]) : 1024;
+    std::size_t hidden = argc > 2 ? std::stoul(argv[2]) : 1024;
+    int threads = argc > 3 ? std::stoi(argv[3]) : 1;
+    const std::size_t samples = 16384;
+    const std::size_t features = 256;
+    const std::size_t classes = 10;
+    const int epochs = 2;
+
+    xt::random::seed(0);
+    Dataloader train_dataloader(synthetic_subset(samples, features, classes), batch_size);
+    Dataloader val_dataloader(synthetic_subset(batch_size, features, classes), batch_size);
+
+    std::cout << "accumulation_bench: " << samples << " samples, batch " << batch_size << ", mlp " << features
+              << "-" << hidden << "-" << hidden << "-" << classes << ", " << threads << " threads" << std::endl;
+    std::cout << std::left << std::setw(8) << "steps" << std::setw(14) << "micro-batch" << std::setw(16) << "workspace MB"
+              << std::setw(14) << "samples/s" << std::setw(12) << "train loss" << std::endl << std::fixed << std::setprecision(3);
+
+    for (std::size_t steps = 1; steps <= batch_size && batch_size % steps == 0 && batch_size / steps >= 8; steps *= 2) {
+        xt::random::seed(0);
+        float train_loss = 0.0f;
+        Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs,
+                    [&](const EpochResult& result) { train_loss = result.train_loss; });
+        model.setThreads(threads);
+        model.setGradAccumulation(steps);
+        model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+        model.addLayer(std::make_unique<activation::Softmax>());
+
+        model.setProgress(false);
+        double elapsed = seconds([&] { model.train(train_dataloader, val_dataloader); });
+
+        double trained = static_cast<double>(epochs) * train_dataloader.n_batches * batch_size;
+        std::cout << std::setw(8) << steps << std::setw(14) << batch_size / steps << std::setw(16)
+                  << model.workspaceBytes() / 1e6 << std::setw(14) << trained / elapsed << std::setw(12) << train_loss << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "layer.hpp"
+
+// Elements/sec of the activation kernels for every ISA the host supports,
+// against the previous path: xt::vectorize over the virtual
+// activation_function forward and xtensor expressions for backward.
+
+struct Case {
+    std::string name;
+    kernels::Activation kind;
+    std::unique_ptr<activation::BaseActivation> layer;
+    float alpha;
+};
+
+template <class F>
+double elements_per_second(std::size_t n, F&& f) {
+    f();
+    int iterations = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    double elapsed = 0.0;
+    do {
+        f();
+        iterations++;
+        elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    } while (elapsed < 0.2);
+    return n * iterations / elapsed;
+}
+
+xt::xarray<float> legacy_backward(kernels::Activation kind, float alpha,
+                                  const Matrix& x, const Matrix& y, const Matrix& dy) {
+    switch (kind) {
+        case kernels::Activation::Sigmoid:
+            return dy * y * (1 - y);
+        case kernels::Activation::Tanh:
+            return dy * (1 - xt::square(y));
+        case kernels::Activation::ReLU:
+            return dy * xt::cast<float>(x > 0);
+        case kernels::Activation::LeakyReLU: {
+            auto grad_mask = xt::cast<float>(x > 0);
+            return dy * (grad_mask + alpha * (1 - grad_mask));
+        }
+        case kernels::Activation::ELU:
+            return dy * xt::where(x >= 0, 1.0f, alpha * xt::exp(x));
+        case kernels::Activation::GELU: {
+            const float sqrt_2_over_pi = std::sqrt(2.0f / M_PI);
+            auto tanh_val = xt::tanh(sqrt_2_over_pi * (x + 0.044715f * xt::pow(x, 3)));
+            return dy * (0.5f * (1.0f + tanh_val + x * (1 - xt::pow(tanh_val, 2)) * sqrt_2_over_pi * (1.0f + 0.134145f * xt::pow(x, 2))));
+        }
+        default:
+            return dy;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::size_t rows = argc > 1 ? std::stoul(argv[1]) : 256;
+    std::size_t cols = argc > 2 ? std::stoul(argv[2]) : 1024;
+    std::size_t n = rows * cols;
+
+    Matrix x = xt::random::randn<float>({rows, cols}, 0.0f, 3.0f);
+    Matrix dy = xt::random::randn<float>({rows, cols});
+    Matrix y = xt::zeros<float>({rows, cols});
+    Matrix dx = xt::zeros<float>({rows, cols});
+
+    Case cases[] = {
+        {"sigmoid", kernels::Activation::Sigmoid, std::make_unique<activation::Sigmoid>(), 0.0f},
+        {"tanh", kernels::Activation::Tanh, std::make_unique<activation::Tanh>(), 0.0f},
+        {"relu", kernels::Activation::ReLU, std::make_unique<activation::ReLU>(), 0.0f},
+        {"leaky_relu", kernels::Activation::LeakyReLU, std::make_unique<activation::LeakyReLU>(), 0.01f},
+        {"elu", kernels::Activation::ELU, std::make_unique<activation::ELU>(1.0f), 1.0f},
+        {"gelu", kernels::Activation::GELU, std::make_unique<activation::GELU>(), 0.0f},
+    };
+
+    std::cout << "activation_bench: " << rows << "x" << cols << " floats, host isa "
+              << kernels::isa_name(kernels::detected_isa()) << ", Gelem/s" << std::endl;
+    std::cout << std::left << std::setw(12) << "activation" << std::setw(10) << "pass"
+              << std::setw(10) << "legacy";
+    for (int isa = 0; isa <= static_cast<int>(kernels::detected_isa()); isa++) {
+        std::cout << std::setw(10) << kernels::isa_name(static_cast<kernels::Isa>(isa));
+    }
+    std::cout << std::endl << std::fixed << std::setprecision(3);
+
+    for (auto& c : cases) {
+        activation::BaseActivation* layer = c.layer.get();
+        layer->forward(x, y);
+
+        double legacy_forward = elements_per_second(n, [&] {
+            auto vecf = xt::vectorize([layer](float v) { return layer->activation_function(v); });
+            xt::xarray<float> out = vecf(x);
+        });
+        double legacy_backward_rate = elements_per_second(n, [&] {
+            xt::xarray<float> out = legacy_backward(c.kind, c.alpha, x, y, dy);
+        });
+
+        std::cout << std::setw(12) << c.name << std::setw(10) << "forward" << std::setw(10) << legacy_forward / 1e9;
+        for (int isa = 0; isa <= static_cast<int>(kernels::detected_isa()); isa++) {
+            auto& ops = kernels::activation_kernels(c.kind, static_cast<kernels::Isa>(isa));
+            std::cout << std::setw(10) << elements_per_second(n, [&] {
+                ops.forward(x.data(), y.data(), n, c.alpha);
+            }) / 1e9;
+        }
+        std::cout << std::endl;
+
+        std::cout << std::setw(12) << c.name << std::setw(10) << "backward" << std::setw(10) << legacy_backward_rate / 1e9;
+        for (int isa = 0; isa <= static_cast<int>(kernels::detected_isa()); isa++) {
+            auto& ops = kernels::activation_kernels(c.kind, static_cast<kernels::Isa>(isa));
+            std::cout << std::setw(10) << elements_per_second(n, [&] {
+                ops.backward(x.data(), y.data(), dy.data(), dx.data(), n, c.alpha);
+            }) / 1e9;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef __BENCH_COMMON_HPP__
+#define __BENCH_COMMON_HPP__
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include "utils/dataset.hpp"
+
+// Helpers shared by the benchmarks.
+
+// Normal features and uniform labels.
+inline Subset synthetic_subset(std::size_t samples, std::size_t features, std::size_t classes) {
+    Matrix data = xt::random::randn<float>({samples, features});
+    xt::xarray<uint> labels = xt::random::randint<uint>({samples}, 0, classes);
+    return Subset::of(std::move(data), labels);
+}
+
+// NHWC images of pixels in [0, 1) and uniform labels.
+inline Subset synthetic_subset(std::size_t samples, const ImageShape& shape, std::size_t classes) {
+    Matrix data = xt::random::rand<float>({samples, shape.size()});
+    xt::xarray<uint> labels = xt::random::randint<uint>({samples}, 0, classes);
+    return Subset::of(std::move(data), labels);
+}
+
+template <class F>
+double seconds(F&& f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Drops std::cout while alive, for the load messages of the datasets.
+class QuietStdout {
+    std::ostringstream sink;
+    std::streambuf* previous;
+
+public:
+    QuietStdout() : previous(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietStdout() { std::cout.rdbuf(previous); }
+};
+
+#endif
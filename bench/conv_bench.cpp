@@ -0,0 +1,101 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "model.hpp"
+#include "bench_common.hpp"
+
+// Images/sec of the small CNN of main.cpp against a dense MLP on random
+// 28x28x1 images, training and inference, with the parameter count of each.
+// A conv-relu-pool-dense stack also trains in mixed precision, where the
+// pool sits right below the last layer and gets bf16-rounded inputs: the
+// bench fails if its convolution never receives a gradient.
+
+void add_cnn(Model& model, const ImageShape& shape, std::size_t classes) {
+    auto conv1 = std::make_unique<Conv2DLayer>(shape, 8, 3);
+    auto pool1 = std::make_unique<MaxPool2D>(conv1->output_image(), 2);
+    auto conv2 = std::make_unique<Conv2DLayer>(pool1->output_image(), 16, 3);
+    auto pool2 = std::make_unique<MaxPool2D>(conv2->output_image(), 2);
+    ImageShape features = pool2->output_image();
+    model.addLayer(std::move(conv1));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::move(pool1));
+    model.addLayer(std::move(conv2));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::move(pool2));
+    model.addLayer(std::make_unique<Flatten>(features));
+    model.addLayer(std::make_unique<DenseLayer>(features.size(), classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+}
+
+// Returns the convolution, to check that its weights train.
+const Conv2DLayer* add_pooled_dense(Model& model, const ImageShape& shape, std::size_t classes) {
+    auto conv = std::make_unique<Conv2DLayer>(shape, 8, 3);
+    auto pool = std::make_unique<MaxPool2D>(conv->output_image(), 2);
+    const Conv2DLayer* first = conv.get();
+    std::size_t features = pool->output_image().size();
+    model.addLayer(std::move(conv));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::move(pool));
+    model.addLayer(std::make_unique<DenseLayer>(features, classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+    return first;
+}
+
+void add_mlp(Model& model, const ImageShape& shape, std::size_t classes) {
+    model.addLayer(std::make_unique<DenseLayer>(shape.size(), 128));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(128, classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? std::stoi(argv[1]) : 1;
+    unsigned int batch_size = argc > 2 ? std::stoul(argv[2]) : 64;
+    int epochs = argc > 3 ? std::stoi(argv[3]) : 2;
+    const std::size_t samples = 8192;
+    const std::size_t classes = 10;
+    const ImageShape shape{28, 28, 1};
+
+    xt::random::seed(0);
+    Dataloader train_dataloader(synthetic_subset(samples, shape, classes), batch_size);
+    Dataloader val_dataloader(synthetic_subset(batch_size, shape, classes), batch_size);
+    Dataloader eval_dataloader(synthetic_subset(samples, shape, classes), batch_size);
+
+    std::cout << "conv_bench: " << samples << " images of 28x28x1, batch " << batch_size << ", "
+              << threads << " threads, " << epochs << " epochs" << std::endl;
+    std::cout << std::left << std::setw(10) << "" << std::setw(12) << "parameters" << std::setw(18) << "train images/s"
+              << std::setw(18) << "eval images/s" << std::endl << std::fixed << std::setprecision(0);
+
+    for (std::string name : {"cnn", "mlp", "pool-bf16"}) {
+        Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs);
+        model.setThreads(threads);
+        const Conv2DLayer* conv = nullptr;
+        if (name == "cnn") {
+            add_cnn(model, shape, classes);
+        } else if (name == "mlp") {
+            add_mlp(model, shape, classes);
+        } else {
+            conv = add_pooled_dense(model, shape, classes);
+            model.setMixedPrecision(true);
+        }
+        Matrix initial_weights = conv ? Matrix(conv->weights.values()) : Matrix();
+
+        model.setProgress(false);
+        double train = seconds([&] { model.train(train_dataloader, val_dataloader); });
+        double eval = seconds([&] { model.evaluate(eval_dataloader); });
+
+        // the last evaluation of every epoch is a single batch, left in the training time
+        double trained = static_cast<double>(epochs) * train_dataloader.n_batches * batch_size;
+        double evaluated = static_cast<double>(eval_dataloader.n_batches) * batch_size;
+        std::cout << std::setw(10) << name << std::setw(12) << model.parameterCount() << std::setw(18)
+                  << trained / train << std::setw(18) << evaluated / eval << std::endl;
+
+        if (conv && initial_weights == conv->weights.values()) {
+            std::cerr << "conv_bench: the convolution below the pool got no gradient in mixed precision" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
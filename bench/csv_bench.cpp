@@ -0,0 +1,60 @@
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/dataset.hpp"
+#include "bench_common.hpp"
+
+// Ingest rate of CsvDataset on a synthetic file of random floats and
+// string labels, with 1, 2, 4, ... parsing threads. The file has just been
+// written, so every run parses it from the page cache.
+
+int main(int argc, char** argv) {
+    std::size_t rows = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    std::size_t features = argc > 2 ? std::stoul(argv[2]) : 32;
+    std::string path = argc > 3 ? argv[3] : "csv_bench.csv";
+
+    {
+        std::ofstream file(path);
+        std::mt19937 engine(0);
+        std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+        file << std::setprecision(7);
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t j = 0; j < features; j++) {
+                file << value(engine) << ',';
+            }
+            file << "class" << i % 10 << '\n';
+        }
+    }
+    std::ifstream written(path, std::ios::binary | std::ios::ate);
+    double bytes = static_cast<double>(written.tellg());
+
+    std::cout << "csv_bench: " << rows << " rows of " << features << " features, " << bytes / 1e6 << " MB" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(12) << "seconds" << std::setw(10) << "GB/s"
+              << std::endl << std::fixed << std::setprecision(3);
+
+    std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> thread_counts;
+    for (std::size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    for (std::size_t threads : thread_counts) {
+        CsvOptions options;
+        options.threads = threads;
+        double elapsed;
+        {
+            // the load summary would interleave with the table
+            QuietStdout quiet;
+            elapsed = seconds([&] { CsvDataset dataset(path, options); });
+        }
+        std::cout << std::setw(10) << threads << std::setw(12) << elapsed << std::setw(10) << bytes / elapsed / 1e9 << std::endl;
+    }
+    std::remove(path.c_str());
+    return 0;
+}
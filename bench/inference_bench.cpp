@@ -0,0 +1,55 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "model.hpp"
+#include "bench_common.hpp"
+
+// Samples/sec and activation memory of evaluate() on a wide MLP, with the
+// no-grad inference layout and with the training layout it replaces.
+
+int main(int argc, char** argv) {
+    unsigned int batch_size = argc > 1 ? std::stoul(argv[1]) : 512;
+    std::size_t hidden = argc > 2 ? std::stoul(argv[2]) : 2048;
+    int repeats = argc > 3 ? std::stoi(argv[3]) : 5;
+    const std::size_t samples = 16384;
+    const std::size_t features = 784;
+    const std::size_t classes = 10;
+
+    xt::random::seed(0);
+    Dataloader dataloader(synthetic_subset(samples, features, classes), batch_size);
+
+    std::cout << "inference_bench: " << samples << " samples, batch " << batch_size << ", mlp " << features
+              << "-" << hidden << "-" << hidden << "-" << hidden << "-" << classes << ", " << repeats
+              << " passes" << std::endl;
+    std::cout << std::left << std::setw(10) << "" << std::setw(14) << "samples/s" << std::setw(16) << "activation MB"
+              << std::setw(10) << "loss" << std::endl << std::fixed << std::setprecision(3);
+
+    for (bool no_grad : {false, true}) {
+        xt::random::seed(1);
+        Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, 1);
+        model.setNoGradInference(no_grad);
+        model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+        model.addLayer(std::make_unique<activation::Softmax>());
+
+        // the first pass sizes the workspace
+        auto [loss, accuracy] = model.evaluate(dataloader);
+        double elapsed = seconds([&] {
+            for (int r = 0; r < repeats; r++) {
+                model.evaluate(dataloader);
+            }
+        });
+
+        double evaluated = static_cast<double>(repeats) * dataloader.n_batches * batch_size;
+        std::cout << std::setw(10) << (no_grad ? "no-grad" : "training") << std::setw(14) << evaluated / elapsed
+                  << std::setw(16) << model.evaluationBytes() / 1e6 << std::setw(10) << loss << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "model.hpp"
+#include "bench_common.hpp"
+
+// Training samples/sec, activation memory and final losses of a wide MLP
+// in fp32 and in bf16 mixed precision, on a synthetic task whose labels are
+// the argmax of a fixed random projection, so both runs have something to fit.
+
+Subset synthetic_subset(std::size_t samples, std::size_t features, std::size_t classes, const Matrix& projection) {
+    Matrix data = xt::random::randn<float>({samples, features});
+    xt::xarray<uint> labels = xt::zeros<uint>({samples});
+    for (std::size_t i = 0; i < samples; i++) {
+        float best = -std::numeric_limits<float>::infinity();
+        for (std::size_t c = 0; c < classes; c++) {
+            float score = 0.0f;
+            for (std::size_t k = 0; k < features; k++) {
+                score += data(i, k) * projection(c, k);
+            }
+            if (score > best) {
+                best = score;
+                labels(i) = static_cast<uint>(c);
+            }
+        }
+    }
+    return Subset::of(std::move(data), labels);
+}
+
+struct Run {
+    double samples_per_s;
+    std::size_t workspace_bytes;
+    float train_loss;
+    float val_loss;
+    float val_accuracy;
+};
+
+Run train(bool mixed, Dataloader& train_dataloader, Dataloader& val_dataloader,
+          std::size_t features, std::size_t hidden, std::size_t classes, int epochs) {
+    xt::random::seed(0);
+    Run run{};
+    Model model(std::make_unique<loss::CrossEntropy>(), 1e-2f, 0.0f, epochs, [&](const EpochResult& result) {
+        run.train_loss = result.train_loss;
+        run.val_loss = result.val_loss;
+        run.val_accuracy = result.val_accuracy;
+    });
+    model.setMixedPrecision(mixed);
+    model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+
+    model.setProgress(false);
+    double elapsed = seconds([&] { model.train(train_dataloader, val_dataloader); });
+
+    run.samples_per_s = static_cast<double>(epochs) * train_dataloader.n_batches * train_dataloader.batch_size / elapsed;
+    run.workspace_bytes = model.workspaceBytes();
+    return run;
+}
+
+int main(int argc, char** argv) {
+    unsigned int batch_size = argc > 1 ? std::stoul(argv[1]) : 256;
+    std::size_t hidden = argc > 2 ? std::stoul(argv[2]) : 1024;
+    int epochs = argc > 3 ? std::stoi(argv[3]) : 3;
+    const std::size_t samples = 16384;
+    const std::size_t features = 256;
+    const std::size_t classes = 10;
+
+    xt::random::seed(1);
+    Matrix projection = xt::random::randn<float>({classes, features});
+    Dataloader train_dataloader(synthetic_subset(samples, features, classes, projection), batch_size);
+    Dataloader val_dataloader(synthetic_subset(4096, features, classes, projection), batch_size);
+
+    std::cout << "mixed_precision_bench: " << samples << " samples, batch " << batch_size << ", mlp " << features
+              << "-" << hidden << "-" << hidden << "-" << hidden << "-" << classes << ", " << epochs << " epochs, bf16 GEMM: "
+              << kernels::bf16_isa_name(kernels::detected_bf16_isa()) << std::endl;
+    std::cout << std::left << std::setw(8) << "" << std::setw(14) << "samples/s" << std::setw(16) << "workspace MB"
+              << std::setw(12) << "train loss" << std::setw(10) << "val loss" << std::setw(10) << "val acc"
+              << std::endl << std::fixed << std::setprecision(3);
+    for (bool mixed : {false, true}) {
+        Run run = train(mixed, train_dataloader, val_dataloader, features, hidden, classes, epochs);
+        std::cout << std::setw(8) << (mixed ? "bf16" : "fp32") << std::setw(14) << run.samples_per_s
+                  << std::setw(16) << run.workspace_bytes / 1e6 << std::setw(12) << run.train_loss
+                  << std::setw(10) << run.val_loss << std::setw(10) << run.val_accuracy << std::endl;
+    }
+    return 0;
+}
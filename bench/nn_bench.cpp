@@ -0,0 +1,350 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "model.hpp"
+#include "utils/idx_dataset.hpp"
+#include "bench_common.hpp"
+
+// Benchmark suite on synthetic data: dense layers on dense and sparse
+// inputs, activations, softmax + cross-entropy, data loading and parsing,
+// and end-to-end training. Every result is a throughput, higher is better.
+//
+//   nn_bench [--filter substring] [--min-time seconds] [--json out.json]
+//            [--baseline baseline.json] [--threshold 0.05]
+//
+// A run saved with --json is a baseline for later runs; with --baseline,
+// results more than `threshold` below it are reported and the exit status
+// is 1. Run with OPENBLAS_NUM_THREADS=1 for stable numbers.
+
+struct Result {
+    std::string name;
+    double value;
+    std::string unit;
+};
+
+class Suite {
+    std::string filter;
+    double min_time;
+
+public:
+    std::vector<Result> results;
+
+    Suite(std::string filter, double min_time) : filter(std::move(filter)), min_time(min_time) {}
+
+    bool enabled(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // Runs `f` (which processes `items` items) for at least min_time seconds.
+    void run(const std::string& name, const std::string& unit, double items, const std::function<void()>& f) {
+        if (!enabled(name)) {
+            return;
+        }
+        f();
+        int iterations = 0;
+        double elapsed = 0.0;
+        auto start = std::chrono::high_resolution_clock::now();
+        do {
+            f();
+            iterations++;
+            elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        } while (elapsed < min_time);
+        record(name, unit, items * iterations / elapsed);
+    }
+
+    void record(const std::string& name, const std::string& unit, double value) {
+        results.push_back({name, value, unit});
+        std::cout << std::left << std::setw(44) << name << std::right << std::setw(16)
+                  << std::fixed << std::setprecision(1) << value << " " << unit << std::endl;
+    }
+};
+
+Matrix random_labels(std::size_t rows, std::size_t classes) {
+    Matrix truths = xt::zeros<float>({rows, std::size_t(1)});
+    for (std::size_t i = 0; i < rows; i++) {
+        truths(i, 0) = static_cast<float>(i % classes);
+    }
+    return truths;
+}
+
+void bench_dense(Suite& suite) {
+    struct Shape { std::size_t batch, in, out; };
+    for (auto shape : {Shape{32, 4, 16}, Shape{128, 64, 256}, Shape{256, 784, 128}, Shape{512, 256, 256}}) {
+        std::string suffix = std::to_string(shape.batch) + "x" + std::to_string(shape.in) + "x" + std::to_string(shape.out);
+        DenseLayer layer(shape.in, shape.out);
+        Matrix x = xt::random::randn<float>({shape.batch, shape.in});
+        Matrix y = xt::zeros<float>({shape.batch, shape.out});
+        Matrix dy = xt::random::randn<float>({shape.batch, shape.out});
+        Matrix dx = xt::zeros<float>({shape.batch, shape.in});
+
+        suite.run("dense/forward/" + suffix, "samples/s", shape.batch, [&] { layer.forward(x, y); });
+        suite.run("dense/backward/" + suffix, "samples/s", shape.batch, [&] { layer.backward(x, y, dy, dx); });
+    }
+}
+
+// First dense layer on 99.5% sparse inputs, dense GEMM against CSR SpMM.
+void bench_sparse_dense(Suite& suite) {
+    const std::size_t batch = 256, in = 20000, out = 128;
+    DenseLayer layer(in, out);
+    Matrix x = xt::zeros<float>({batch, in});
+    for (std::size_t i = 0; i < batch; i++) {
+        for (std::size_t k = 0; k < in / 200; k++) {
+            x(i, (i * 7919 + k * 211) % in) = 1.0f;
+        }
+    }
+    CsrMatrix x_sparse = CsrMatrix::from_dense(x.data(), batch, in);
+    Matrix y = xt::zeros<float>({batch, out});
+    Matrix dy = xt::random::randn<float>({batch, out});
+    Matrix dx = xt::zeros<float>({batch, in});
+
+    std::string suffix = std::to_string(batch) + "x" + std::to_string(in) + "x" + std::to_string(out);
+    suite.run("sparse/dense_forward/" + suffix, "samples/s", batch, [&] { layer.forward(x, y); });
+    suite.run("sparse/csr_forward/" + suffix, "samples/s", batch, [&] { layer.forward_sparse(x_sparse, y); });
+    suite.run("sparse/dense_backward/" + suffix, "samples/s", batch, [&] { layer.backward(x, y, dy, dx); });
+    suite.run("sparse/csr_backward/" + suffix, "samples/s", batch, [&] { layer.backward_sparse(x_sparse, y, dy); });
+}
+
+void bench_activations(Suite& suite) {
+    const std::size_t rows = 256, cols = 1024;
+    Matrix x = xt::random::randn<float>({rows, cols}, 0.0f, 3.0f);
+    Matrix y = xt::zeros<float>({rows, cols});
+    Matrix dy = xt::random::randn<float>({rows, cols});
+    Matrix dx = xt::zeros<float>({rows, cols});
+
+    std::pair<std::string, std::unique_ptr<activation::BaseActivation>> cases[] = {
+        {"sigmoid", std::make_unique<activation::Sigmoid>()},
+        {"tanh", std::make_unique<activation::Tanh>()},
+        {"relu", std::make_unique<activation::ReLU>()},
+        {"leaky_relu", std::make_unique<activation::LeakyReLU>()},
+        {"elu", std::make_unique<activation::ELU>(1.0f)},
+        {"gelu", std::make_unique<activation::GELU>()},
+    };
+    for (auto& [name, layer] : cases) {
+        suite.run("activation/" + name + "/forward", "elements/s", rows * cols, [&] { layer->forward(x, y); });
+        suite.run("activation/" + name + "/backward", "elements/s", rows * cols, [&] { layer->backward(x, y, dy, dx); });
+    }
+}
+
+void bench_softmax_cross_entropy(Suite& suite) {
+    const std::size_t rows = 512, classes = 10;
+    Matrix logits = xt::random::randn<float>({rows, classes});
+    Matrix probabilities = xt::zeros<float>({rows, classes});
+    Matrix gradient = xt::zeros<float>({rows, classes});
+    Matrix downstream = xt::zeros<float>({rows, classes});
+    Matrix truths = random_labels(rows, classes);
+    activation::Softmax softmax;
+    loss::CrossEntropy cross_entropy;
+
+    suite.run("softmax_cross_entropy/separate", "samples/s", rows, [&] {
+        softmax.forward(logits, probabilities);
+        cross_entropy.forward(probabilities, truths);
+        cross_entropy.backward(probabilities, truths, gradient);
+        softmax.backward(logits, probabilities, gradient, downstream);
+    });
+    suite.run("softmax_cross_entropy/fused", "samples/s", rows, [&] {
+        cross_entropy.forward_backward_logits(logits, truths, downstream);
+    });
+}
+
+void bench_dataloader(Suite& suite) {
+    const std::size_t samples = 16384, features = 784, batch_size = 256;
+    Dataloader sequential(synthetic_subset(samples, features, 10), batch_size);
+    Dataloader shuffled(synthetic_subset(samples, features, 10), batch_size, true);
+    Matrix x, y;
+    std::vector<std::size_t> order;
+    double epoch_samples = static_cast<double>(sequential.n_batches) * batch_size;
+
+    suite.run("dataloader/sequential", "samples/s", epoch_samples, [&] {
+        for (unsigned int batch = 0; batch < sequential.n_batches; batch++) {
+            sequential.load_batch(batch, x, y);
+        }
+    });
+    unsigned int epoch = 0;
+    suite.run("dataloader/shuffled", "samples/s", epoch_samples, [&] {
+        shuffled.epoch_indices(epoch++, order);
+        for (unsigned int batch = 0; batch < shuffled.n_batches; batch++) {
+            shuffled.gather(order.data() + batch * batch_size, batch_size, x, y);
+        }
+    });
+}
+
+void write_big_endian(std::ofstream& out, uint32_t value) {
+    unsigned char bytes[4] = {
+        static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16),
+        static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value),
+    };
+    out.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void bench_parsing(Suite& suite, const std::filesystem::path& directory) {
+    const std::size_t images = 10000, rows = 28, cols = 28;
+    auto images_path = (directory / "images-idx3-ubyte").string();
+    auto labels_path = (directory / "labels-idx1-ubyte").string();
+    {
+        std::vector<char> pixels(images * rows * cols);
+        for (std::size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<char>(i * 2654435761u >> 24);
+        }
+        std::ofstream out(images_path, std::ios::binary);
+        write_big_endian(out, 0x00000803);
+        write_big_endian(out, images);
+        write_big_endian(out, rows);
+        write_big_endian(out, cols);
+        out.write(pixels.data(), pixels.size());
+
+        std::ofstream labels(labels_path, std::ios::binary);
+        write_big_endian(labels, 0x00000801);
+        write_big_endian(labels, images);
+        for (std::size_t i = 0; i < images; i++) {
+            labels.put(static_cast<char>(i % 10));
+        }
+    }
+    suite.run("parse/load_idx_data", "samples/s", images, [&] {
+        auto [x, y] = load_idx_data(images_path, labels_path);
+    });
+    std::vector<float> x(images * rows * cols), y(images);
+    suite.run("parse/idx_source", "samples/s", images, [&] {
+        IdxSource source(images_path, labels_path);
+        source.load_rows(0, images, x.data(), y.data());
+    });
+
+    const std::size_t iris_rows = 15000;
+    auto iris_path = (directory / "iris.data").string();
+    {
+        const char* species[] = {"Iris-setosa", "Iris-versicolor", "Iris-virginica"};
+        std::ofstream out(iris_path);
+        for (std::size_t i = 0; i < iris_rows; i++) {
+            out << 4.0f + (i % 40) * 0.1f << "," << 2.0f + (i % 23) * 0.1f << ","
+                << 1.0f + (i % 59) * 0.1f << "," << 0.1f + (i % 25) * 0.1f << "," << species[i % 3] << "\n";
+        }
+    }
+    suite.run("parse/iris", "samples/s", iris_rows, [&] {
+        QuietStdout quiet;
+        IrisDataset dataset(iris_path);
+    });
+}
+
+void bench_train(Suite& suite) {
+    const std::size_t samples = 8192, features = 64, hidden = 128, classes = 10;
+    const unsigned int batch_size = 256;
+    const int epochs = 2;
+    Dataloader train_dataloader(synthetic_subset(samples, features, classes), batch_size, true);
+    Dataloader val_dataloader(synthetic_subset(batch_size, features, classes), batch_size);
+
+    for (int threads : {1, 4}) {
+        std::string name = "train/mlp_" + std::to_string(features) + "-" + std::to_string(hidden) + "-"
+            + std::to_string(classes) + "/threads_" + std::to_string(threads);
+        if (!suite.enabled(name)) {
+            continue;
+        }
+        xt::random::seed(0);
+        Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs);
+        model.setThreads(threads);
+        model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+        model.addLayer(std::make_unique<activation::Softmax>());
+
+        model.setProgress(false);
+        double elapsed = seconds([&] { model.train(train_dataloader, val_dataloader); });
+
+        suite.record(name, "samples/s", static_cast<double>(epochs) * train_dataloader.n_batches * batch_size / elapsed);
+    }
+}
+
+// Number of results more than `threshold` below their baseline value.
+int compare(const std::vector<Result>& results, const nlohmann::json& baseline, double threshold) {
+    int regressions = 0;
+    std::cout << std::endl << "against baseline (threshold " << threshold * 100.0 << "%)" << std::endl;
+    for (const auto& result : results) {
+        if (!baseline["results"].contains(result.name)) {
+            std::cout << std::left << std::setw(44) << result.name << "   new" << std::endl;
+            continue;
+        }
+        double reference = baseline["results"][result.name]["value"];
+        double change = result.value / reference - 1.0;
+        bool regressed = change < -threshold;
+        regressions += regressed;
+        std::cout << std::left << std::setw(44) << result.name << std::right << std::setw(9)
+                  << std::showpos << std::setprecision(1) << change * 100.0 << std::noshowpos << "%"
+                  << (regressed ? "   REGRESSION" : "") << std::endl;
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string json_path;
+    std::string baseline_path;
+    double min_time = 0.2;
+    double threshold = 0.05;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "nn_bench: missing value for " << arg << std::endl;
+            return 2;
+        }
+        if (arg == "--filter") {
+            filter = argv[++i];
+        } else if (arg == "--min-time") {
+            min_time = std::stod(argv[++i]);
+        } else if (arg == "--json") {
+            json_path = argv[++i];
+        } else if (arg == "--baseline") {
+            baseline_path = argv[++i];
+        } else if (arg == "--threshold") {
+            threshold = std::stod(argv[++i]);
+        } else {
+            std::cerr << "nn_bench: unknown argument " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    xt::random::seed(0);
+    auto directory = std::filesystem::temp_directory_path() / ("nn_bench_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+
+    std::cout << "nn_bench: host isa " << kernels::isa_name(kernels::detected_isa()) << std::endl;
+    Suite suite(filter, min_time);
+    bench_dense(suite);
+    bench_sparse_dense(suite);
+    bench_activations(suite);
+    bench_softmax_cross_entropy(suite);
+    bench_dataloader(suite);
+    bench_parsing(suite, directory);
+    bench_train(suite);
+    std::filesystem::remove_all(directory);
+
+    if (!json_path.empty()) {
+        nlohmann::json output;
+        output["isa"] = kernels::isa_name(kernels::detected_isa());
+        output["min_time"] = min_time;
+        output["results"] = nlohmann::json::object();
+        for (const auto& result : suite.results) {
+            output["results"][result.name] = {{"value", result.value}, {"unit", result.unit}};
+        }
+        std::ofstream(json_path) << output.dump(2) << std::endl;
+    }
+
+    if (!baseline_path.empty()) {
+        std::ifstream in(baseline_path);
+        if (!in) {
+            std::cerr << "nn_bench: unable to open baseline " << baseline_path << std::endl;
+            return 2;
+        }
+        int regressions = compare(suite.results, nlohmann::json::parse(in), threshold);
+        if (regressions > 0) {
+            std::cout << regressions << " regression(s)" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "model.hpp"
+
+// Load generator for Model::predict: closed-loop clients each submit one
+// sample and wait for its result, against a grid of micro-batching limits.
+// Shows how the batch size and delay bounds trade latency for throughput.
+
+int main(int argc, char** argv) {
+    int clients = argc > 1 ? std::stoi(argv[1]) : 32;
+    double seconds = argc > 2 ? std::stod(argv[2]) : 1.0;
+    const std::size_t features = 64;
+    const std::size_t hidden = 256;
+    const std::size_t classes = 10;
+
+    xt::random::seed(0);
+    Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, 1);
+    model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+
+    std::cout << "predict_bench: " << clients << " closed-loop clients, mlp " << features << "-" << hidden
+              << "-" << hidden << "-" << classes << std::endl;
+    std::cout << std::left << std::setw(11) << "max_batch" << std::setw(11) << "delay_us" << std::setw(12) << "req/s"
+              << std::setw(10) << "p50_us" << std::setw(10) << "p99_us" << std::setw(10) << "mean_fill" << std::endl
+              << std::fixed << std::setprecision(1);
+
+    for (std::size_t max_batch : {1, 8, 32, 128}) {
+        for (int delay_us : {0, 100, 1000}) {
+            model.setBatching(max_batch, std::chrono::microseconds(delay_us));
+            // warm up the dispatcher and its workspaces
+            model.predict(std::vector<float>(features, 0.5f)).get();
+
+            std::atomic<bool> running{true};
+            std::atomic<std::size_t> completed{0};
+            std::vector<std::thread> threads;
+            auto start = std::chrono::steady_clock::now();
+            for (int c = 0; c < clients; c++) {
+                threads.emplace_back([&, c] {
+                    std::vector<float> sample(features, 0.01f * c);
+                    while (running.load(std::memory_order_relaxed)) {
+                        model.predict(sample).get();
+                        completed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+            running = false;
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            auto stats = model.predictionStats();
+            std::cout << std::setw(11) << max_batch << std::setw(11) << delay_us << std::setw(12) << completed / elapsed
+                      << std::setw(10) << stats.p50_us << std::setw(10) << stats.p99_us
+                      << std::setw(10) << stats.mean_batch_size << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "model.hpp"
+#include "bench_common.hpp"
+
+// Memory against throughput of activation recompute on a deep MLP: the
+// same training with every activation kept, with segments of 2, 4, ...
+// layers recomputed in backward, and with the segment picked from a budget
+// of half the memory of the first run.
+
+int main(int argc, char** argv) {
+    unsigned int batch_size = argc > 1 ? std::stoul(argv[1]) : 256;
+    std::size_t hidden = argc > 2 ? std::stoul(argv[2]) : 512;
+    std::size_t depth = argc > 3 ? std::stoul(argv[3]) : 16;
+    const std::size_t samples = 8192;
+    const std::size_t features = 256;
+    const std::size_t classes = 10;
+    const int epochs = 2;
+
+    xt::random::seed(0);
+    Dataloader train_dataloader(synthetic_subset(samples, features, classes), batch_size);
+    Dataloader val_dataloader(synthetic_subset(batch_size, features, classes), batch_size);
+
+    std::cout << "recompute_bench: " << samples << " samples, batch " << batch_size << ", " << depth
+              << " hidden layers of " << hidden << std::endl;
+    std::cout << std::left << std::setw(10) << "segment" << std::setw(16) << "workspace MB" << std::setw(14) << "samples/s"
+              << std::setw(12) << "train loss" << std::endl << std::fixed << std::setprecision(3);
+
+    std::size_t full_bytes = 0;
+    std::vector<std::size_t> segments{1};
+    for (std::size_t segment = 2; segment <= 2 * depth; segment *= 2) {
+        segments.push_back(segment);
+    }
+    // 0 stands for the budget run
+    segments.push_back(0);
+
+    for (std::size_t segment : segments) {
+        xt::random::seed(0);
+        float train_loss = 0.0f;
+        Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs,
+                    [&](const EpochResult& result) { train_loss = result.train_loss; });
+        if (segment == 0) {
+            model.setActivationBudget(full_bytes / 2);
+        } else {
+            model.setRecomputeSegment(segment);
+        }
+        model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+        model.addLayer(std::make_unique<activation::ReLU>());
+        for (std::size_t d = 1; d < depth; d++) {
+            model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+            model.addLayer(std::make_unique<activation::ReLU>());
+        }
+        model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+        model.addLayer(std::make_unique<activation::Softmax>());
+
+        model.setProgress(false);
+        double elapsed = seconds([&] { model.train(train_dataloader, val_dataloader); });
+
+        if (segment == 1) {
+            full_bytes = model.workspaceBytes();
+        }
+        double trained = static_cast<double>(epochs) * train_dataloader.n_batches * batch_size;
+        std::cout << std::setw(10) << (segment == 0 ? "budget" : std::to_string(segment)) << std::setw(16)
+                  << model.workspaceBytes() / 1e6 << std::setw(14) << trained / elapsed << std::setw(12) << train_loss
+                  << std::endl;
+    }
+    return 0;
+}
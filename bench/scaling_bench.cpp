@@ -0,0 +1,59 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "model.hpp"
+#include "bench_common.hpp"
+
+// Training samples/sec of the data-parallel path for 1..N threads on a
+// synthetic classification task. Run with OPENBLAS_NUM_THREADS=1 so BLAS
+// threads do not compete with the workers.
+
+double samples_per_second(int threads, Dataloader& train_dataloader, Dataloader& val_dataloader,
+                          std::size_t features, std::size_t hidden, std::size_t classes, int epochs) {
+    xt::random::seed(0);
+    Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs);
+    model.setThreads(threads);
+    model.addLayer(std::make_unique<DenseLayer>(features, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, hidden));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(hidden, classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+
+    model.setProgress(false);
+    double elapsed = seconds([&] { model.train(train_dataloader, val_dataloader); });
+
+    double samples = static_cast<double>(epochs) * train_dataloader.n_batches * train_dataloader.batch_size;
+    return samples / elapsed;
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? std::stoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    unsigned int batch_size = argc > 2 ? std::stoul(argv[2]) : 512;
+    std::size_t hidden = argc > 3 ? std::stoul(argv[3]) : 256;
+    const std::size_t samples = 32768;
+    const std::size_t features = 64;
+    const std::size_t classes = 10;
+    const int epochs = 3;
+
+    Dataloader train_dataloader(synthetic_subset(samples, features, classes), batch_size);
+    Dataloader val_dataloader(synthetic_subset(batch_size, features, classes), batch_size);
+
+    std::cout << "scaling_bench: " << samples << " samples, batch " << batch_size
+              << ", mlp " << features << "-" << hidden << "-" << hidden << "-" << classes << std::endl;
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(16) << "samples/s"
+              << std::setw(10) << "speedup" << std::endl << std::fixed << std::setprecision(2);
+
+    double baseline = 0.0;
+    for (int threads = 1; threads <= max_threads; threads = threads < 4 ? threads + 1 : threads * 2) {
+        double rate = samples_per_second(threads, train_dataloader, val_dataloader, features, hidden, classes, epochs);
+        if (threads == 1) {
+            baseline = rate;
+        }
+        std::cout << std::setw(10) << threads << std::setw(16) << rate << std::setw(10) << rate / baseline << std::endl;
+    }
+    return 0;
+}
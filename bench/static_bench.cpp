@@ -0,0 +1,64 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "static_model.hpp"
+#include "bench_common.hpp"
+
+// Per-sample latency of StaticModel against the dynamic Model, on the
+// Iris-sized 4-16-3 network of main.cpp and synthetic data: training at
+// the config's batch size, evaluation one sample per batch, and a single
+// StaticModel::predict call.
+
+int main(int argc, char** argv) {
+    unsigned int batch_size = argc > 1 ? std::stoul(argv[1]) : 32;
+    int epochs = argc > 2 ? std::stoi(argv[2]) : 20;
+    const std::size_t samples = 4096;
+
+    xt::random::seed(0);
+    Dataloader train_dataloader(synthetic_subset(samples, 4, 3), batch_size, true);
+    Dataloader val_dataloader(synthetic_subset(batch_size, 4, 3), batch_size);
+    Dataloader eval_dataloader(synthetic_subset(samples, 4, 3), 1);
+    double trained_samples = static_cast<double>(epochs) * train_dataloader.n_batches * batch_size;
+
+    Model model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs);
+    model.addLayer(std::make_unique<DenseLayer>(4, 16));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(16, 3));
+    model.addLayer(std::make_unique<activation::Softmax>());
+
+    StaticModel<fixed::Dense<4, 16>, fixed::ReLU, fixed::Dense<16, 3>, fixed::Softmax>
+        static_model(std::make_unique<loss::CrossEntropy>(), 1e-3f, 0.0f, epochs);
+
+    model.setProgress(false);
+    double model_train = seconds([&] { model.train(train_dataloader, val_dataloader); });
+    double static_train = seconds([&] { static_model.train(train_dataloader, val_dataloader); });
+
+    double model_eval = seconds([&] { model.evaluate(eval_dataloader); });
+    double static_eval = seconds([&] { static_model.evaluate(eval_dataloader); });
+
+    const int predictions = 1000000;
+    decltype(static_model)::Input features{0.1f, -0.3f, 0.7f, 1.2f};
+    float checksum = 0.0f;
+    double static_predict = seconds([&] {
+        for (int i = 0; i < predictions; i++) {
+            features[0] = static_cast<float>(i & 7);
+            checksum += static_model.predict(features)[0];
+        }
+    });
+
+    // training includes a one-batch validation per epoch in both models
+    std::cout << "static_bench: mlp 4-16-3, batch " << batch_size << ", " << epochs << " epochs, ns/sample" << std::endl;
+    std::cout << std::left << std::setw(22) << "" << std::setw(14) << "Model" << std::setw(14) << "StaticModel"
+              << std::setw(10) << "speedup" << std::endl << std::fixed << std::setprecision(1);
+    auto row = [](const std::string& name, double dynamic_ns, double static_ns) {
+        std::cout << std::setw(22) << name << std::setw(14) << dynamic_ns << std::setw(14) << static_ns
+                  << std::setw(10) << dynamic_ns / static_ns << std::endl;
+    };
+    row("train", model_train / trained_samples * 1e9, static_train / trained_samples * 1e9);
+    row("evaluate (batch 1)", model_eval / samples * 1e9, static_eval / samples * 1e9);
+    std::cout << std::setw(22) << "predict" << std::setw(14) << "-" << std::setw(14)
+              << static_predict / predictions * 1e9 << "   (checksum " << checksum << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef __CHECKPOINT_HPP__
+#define __CHECKPOINT_HPP__
+
+#include "layer.hpp"
+#include "utils/mapped_file.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Binary checkpoint, in host byte order:
+//   Header                      64 bytes
+//   LayerRecord[layer_count]    the layer graph, 64 bytes each
+//   parameter values            the ParameterArena as is, 64-byte aligned
+//   optimizer buffers           optimizer_buffers blobs of the arena size
+// Every blob starts on a 64-byte boundary and the arena layout keeps each
+// parameter aligned too, so a mapped checkpoint is used in place.
+namespace checkpoint {
+    constexpr char magic[8] = {'N', 'N', 'C', 'K', 'P', 'T', 0, 0};
+    constexpr uint32_t version = 2;
+
+    enum class LayerType : uint32_t {
+        Dense = 1, DenseActivation = 2, Activation = 3, Softmax = 4, Conv2D = 5, MaxPool2D = 6, Flatten = 7
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t layer_count;
+        uint64_t parameter_count;   // floats in the arena, padding included
+        uint32_t optimizer_buffers;
+        int32_t epoch;              // last completed epoch
+        int64_t optimizer_steps;
+        float dynamic_lr;           // learning rate of the next epoch
+        uint8_t reserved[20];
+    };
+    static_assert(sizeof(Header) == 64);
+
+    struct LayerRecord {
+        uint32_t type;
+        uint32_t activation;        // kernels::Activation
+        float alpha;
+        uint32_t reserved;
+        uint64_t input_size;        // dense layers only
+        uint64_t output_size;
+        uint32_t height;            // input image of the image layers
+        uint32_t width;
+        uint32_t channels;
+        uint32_t filters;           // Conv2D only
+        uint32_t window;            // kernel or pool size
+        uint32_t stride;
+        uint32_t padding;
+        uint32_t reserved_image;
+    };
+    static_assert(sizeof(LayerRecord) == 64);
+
+    std::size_t parameters_offset(std::size_t layer_count);
+
+    // Graph record of a layer; throws for layers the format cannot store.
+    LayerRecord describe(const Layer& layer);
+    // Layer with the architecture of `record` and fresh parameters.
+    std::unique_ptr<Layer> make_layer(const LayerRecord& record);
+    bool same_layer(const LayerRecord& a, const LayerRecord& b);
+
+    struct State {
+        const float* parameters;
+        std::size_t parameter_count;
+        std::vector<float*> optimizer;
+        long optimizer_steps;
+        int epoch;
+        float dynamic_lr;
+    };
+
+    // Serializes a whole checkpoint into `out`, reusing its capacity.
+    void serialize(const std::vector<std::unique_ptr<Layer>>& layers, const State& state, std::vector<char>& out);
+
+    // A checkpoint file mapped copy-on-write: the parameters can be trained
+    // in place and only the pages touched become private copies.
+    class Reader {
+        std::shared_ptr<MappedFile> file;
+        Header file_header;
+
+    public:
+        explicit Reader(const std::string& path);
+
+        const Header& header() const { return file_header; }
+        std::vector<LayerRecord> layers() const;
+        float* parameters();
+        const float* optimizer_buffer(std::size_t index) const;
+        std::shared_ptr<MappedFile> mapping() const { return file; }
+    };
+
+    // Writes checkpoints to `path` on a background thread. submit() only
+    // swaps buffers, so the caller never waits for the disk; if a snapshot
+    // is still queued when the next one comes, only the newest is written.
+    // Each file is written next to `path` and renamed over it, so a crash
+    // mid-write leaves the previous checkpoint intact.
+    class AsyncWriter {
+        std::string path;
+        std::vector<char> pending;
+        bool has_pending = false;
+        bool writing = false;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable work_cv;
+        std::condition_variable idle_cv;
+        std::thread writer;
+
+        void run();
+
+    public:
+        explicit AsyncWriter(std::string path);
+        ~AsyncWriter();
+
+        AsyncWriter(const AsyncWriter&) = delete;
+        AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+        // Takes the content of `bytes` and hands back a spare buffer.
+        void submit(std::vector<char>& bytes);
+        // Blocks until every submitted checkpoint is on disk.
+        void flush();
+    };
+}
+
+#endif
@@ -6,12 +6,29 @@
 #include <xtensor/containers/xadapt.hpp>
 #include <xtensor/generators/xrandom.hpp>
 #include <xtensor/core/xvectorize.hpp>
+#include <xtensor/core/xnoalias.hpp>
 #include <xtensor/misc/xsort.hpp>
 #include <xtensor-blas/xblas.hpp>
 #include <xtensor-blas/xlinalg.hpp>
 
 #include <nlohmann/json.hpp>
 
+// (batch, features) buffer used on the hot path. Fixed rank so shapes live on
+// the stack and resizing to the same shape never touches the heap.
+using Matrix = xt::xtensor<float, 2>;
+// bf16 (raw uint16_t bits, see kernels/bf16.hpp) copy of a Matrix for mixed precision.
+using Bf16Matrix = xt::xtensor<uint16_t, 2>;
+
+// Dimensions of the images held in the rows of a Matrix, each row one image
+// in NHWC order: rows, then columns, then channels.
+struct ImageShape {
+    std::size_t height;
+    std::size_t width;
+    std::size_t channels;
+
+    std::size_t size() const { return height * width * channels; }
+};
+
 std::string xarray_shape(const xt::xarray<float>& arr);
 nlohmann::json load_json(const std::string& path);
 
@@ -0,0 +1,88 @@
+#ifndef __CONV_LAYER_HPP__
+#define __CONV_LAYER_HPP__
+
+#include "layer.hpp"
+
+// Image layers. A batch stays a (batch, height * width * channels) Matrix
+// whose rows are NHWC images, the layout of IDX files, so the data reaches
+// the first convolution without a reshape or a copy.
+
+// 2D convolution lowered to a GEMM: a block of images is unrolled into an
+// im2col buffer sized to stay in L2, then multiplied by the filters on the
+// same BLAS path as DenseLayer. The GEMM output is already NHWC.
+class Conv2DLayer: public Layer {
+    ImageShape input_shape;
+    ImageShape output_shape;
+    std::size_t kernel_size;
+    std::size_t stride;
+    std::size_t padding;
+
+    void im2col(const float* images, std::size_t n_images, float* columns) const;
+    void col2im(const float* columns, std::size_t n_images, float* images) const;
+    std::size_t block_images() const;
+
+public:
+    Parameter weights;  // (filters, kernel_size * kernel_size * channels), each row a HWC filter
+    Parameter biases;   // (1, filters)
+
+    Conv2DLayer(ImageShape input_shape, std::size_t filters, std::size_t kernel_size,
+                std::size_t stride = 1, std::size_t padding = 0);
+
+    const ImageShape& input_image() const { return input_shape; }
+    const ImageShape& output_image() const { return output_shape; }
+    std::size_t kernel() const { return kernel_size; }
+    std::size_t step() const { return stride; }
+    std::size_t pad() const { return padding; }
+
+    std::size_t output_size(std::size_t input_size) const override;
+    double flops(std::size_t rows, std::size_t input_size, bool backward) const override;
+    std::vector<Parameter*> parameters() override { return {&weights, &biases}; }
+    std::unique_ptr<Layer> replicate() const override;
+    void forward(const Matrix& inputs, Matrix& outputs) override;
+    void backward(const Matrix& inputs, const Matrix& outputs,
+                  const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
+};
+
+// Max over pool x pool windows of every channel. backward finds the argmax
+// again from the inputs, so nothing is kept between the passes.
+class MaxPool2D: public Layer {
+    ImageShape input_shape;
+    ImageShape output_shape;
+    std::size_t pool;
+    std::size_t stride;
+
+public:
+    // stride 0 means non-overlapping windows (stride = pool)
+    MaxPool2D(ImageShape input_shape, std::size_t pool, std::size_t stride = 0);
+
+    const ImageShape& input_image() const { return input_shape; }
+    const ImageShape& output_image() const { return output_shape; }
+    std::size_t window() const { return pool; }
+    std::size_t step() const { return stride; }
+
+    std::size_t output_size(std::size_t input_size) const override;
+    double flops(std::size_t rows, std::size_t input_size, bool backward) const override;
+    void forward(const Matrix& inputs, Matrix& outputs) override;
+    void backward(const Matrix& inputs, const Matrix& outputs,
+                  const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
+};
+
+// Marks the end of the image layers. Rows are flat NHWC already, so it
+// only checks the width and passes the values through.
+class Flatten: public Layer {
+    ImageShape input_shape;
+
+public:
+    explicit Flatten(ImageShape input_shape) : input_shape(input_shape) {}
+
+    const ImageShape& input_image() const { return input_shape; }
+
+    std::size_t output_size(std::size_t input_size) const override;
+    double flops(std::size_t rows, std::size_t input_size, bool backward) const override { return 0.0; }
+    bool in_place() const override { return true; }
+    void forward(const Matrix& inputs, Matrix& outputs) override;
+    void backward(const Matrix& inputs, const Matrix& outputs,
+                  const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __ACTIVATION_KERNELS_HPP__
+#define __ACTIVATION_KERNELS_HPP__
+
+#include <cstddef>
+
+// Contiguous elementwise activation kernels, vectorized for AVX2 and AVX-512
+// and selected once at runtime from the host CPU features. exp and tanh use
+// polynomial approximations: exp has a relative error below 3e-7 on
+// [-86, 88] (inputs outside the range saturate), tanh an absolute error
+// below 3e-7 everywhere.
+namespace kernels {
+    enum class Activation { Identity, Sigmoid, Tanh, ReLU, LeakyReLU, ELU, GELU, Count };
+    enum class Isa { Scalar, AVX2, AVX512 };
+
+    // y = f(x); x and y may alias
+    using ForwardKernel = void (*)(const float* x, float* y, std::size_t n, float alpha);
+    // y = f(x + bias), the epilogue of a dense layer; x and y may alias
+    using ForwardBiasKernel = void (*)(const float* x, const float* bias, float* y, std::size_t n, float alpha);
+    // dx = dy * f'(x); y = f(x) is passed so kernels can reuse it instead of recomputing
+    using BackwardKernel = void (*)(const float* x, const float* y, const float* dy, float* dx,
+                                    std::size_t n, float alpha);
+
+    struct ActivationKernels {
+        ForwardKernel forward;
+        BackwardKernel backward;
+        ForwardBiasKernel forward_bias;
+    };
+
+    Isa detected_isa();
+    const char* isa_name(Isa isa);
+
+    // Kernels for the best ISA supported by the host.
+    const ActivationKernels& activation_kernels(Activation kind);
+    // Kernels for an explicit ISA, which must be supported by the host.
+    const ActivationKernels& activation_kernels(Activation kind, Isa isa);
+}
+
+#endif
\ No newline at end of file
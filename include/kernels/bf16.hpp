@@ -0,0 +1,58 @@
+#ifndef __BF16_HPP__
+#define __BF16_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// bfloat16 storage for mixed-precision training: the upper half of an fp32,
+// so conversion is a rounding shift and the range is fp32's. The GEMM reads
+// bf16 operands and accumulates in fp32, with vdpbf16ps on AVX512-BF16 and
+// widen + FMA on AVX2.
+namespace kernels {
+    using bf16 = uint16_t;
+
+    // Rows of bf16 operands are zero-padded to a multiple of this many elements.
+    constexpr std::size_t bf16_k_alignment = 32;
+
+    enum class Bf16Isa { Scalar, AVX2, AVX512BF16 };
+
+    // c[i * ldc + j] = sum_k a[i * k_padded + k] * w[j * k_padded + k]
+    using Bf16GemmKernel = void (*)(const bf16* a, const bf16* w, float* c,
+                                    std::size_t rows, std::size_t cols, std::size_t k_padded, std::size_t ldc);
+
+    Bf16Isa detected_bf16_isa();
+    const char* bf16_isa_name(Bf16Isa isa);
+
+    // Kernel for the best ISA supported by the host, or an explicit one.
+    Bf16GemmKernel bf16_gemm_kernel();
+    Bf16GemmKernel bf16_gemm_kernel(Bf16Isa isa);
+
+    // Round to nearest even; NaNs stay NaNs.
+    inline bf16 to_bf16(float x) {
+        uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        if ((bits & 0x7fffffffu) > 0x7f800000u) {
+            return static_cast<bf16>((bits >> 16) | 0x40);
+        }
+        return static_cast<bf16>((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+    }
+
+    inline float from_bf16(bf16 x) {
+        uint32_t bits = static_cast<uint32_t>(x) << 16;
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    // Converts (rows, cols) row-major floats to bf16 rows of `stride` elements, zero padded.
+    void to_bf16_rows(const float* x, bf16* y, std::size_t rows, std::size_t cols, std::size_t stride);
+    // Converts bf16 rows of `stride` elements back to (rows, cols) floats.
+    void from_bf16_rows(const bf16* x, float* y, std::size_t rows, std::size_t cols, std::size_t stride);
+
+    inline std::size_t bf16_padded(std::size_t k) {
+        return (k + bf16_k_alignment - 1) / bf16_k_alignment * bf16_k_alignment;
+    }
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __GATHER_HPP__
+#define __GATHER_HPP__
+
+#include <cstddef>
+
+namespace kernels {
+    // dst[i] = src row indices[i], for rows of row_size floats. The rows of
+    // the next few indices are prefetched while the current one is copied,
+    // since a random permutation defeats the hardware prefetcher.
+    void gather_rows(const float* src, std::size_t row_size, const std::size_t* indices,
+                     std::size_t count, float* dst);
+}
+
+#endif
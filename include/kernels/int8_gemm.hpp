@@ -0,0 +1,37 @@
+#ifndef __INT8_GEMM_HPP__
+#define __INT8_GEMM_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+// Integer GEMM for quantized inference: uint8 activations times int8 weights,
+// accumulated in int32. Activations are quantized to [0, 127] so that the
+// pairwise int16 sums of vpmaddubsw (AVX2) can never saturate; the VNNI path
+// (vpdpbusd) gets the same inputs and returns bit-identical results.
+namespace kernels {
+    constexpr int activation_qmax = 127;
+    // Rows of both operands are zero-padded to a multiple of this many bytes.
+    constexpr std::size_t int8_k_alignment = 64;
+
+    enum class Int8Isa { Scalar, AVX2, VNNI };
+
+    // c[i * cols + j] = sum_k a[i * k_padded + k] * w[j * k_padded + k]
+    using Int8GemmKernel = void (*)(const uint8_t* a, const int8_t* w, int32_t* c,
+                                    std::size_t rows, std::size_t cols, std::size_t k_padded);
+
+    Int8Isa detected_int8_isa();
+    const char* int8_isa_name(Int8Isa isa);
+
+    // Kernel for the best ISA supported by the host, or an explicit one.
+    Int8GemmKernel int8_gemm_kernel();
+    Int8GemmKernel int8_gemm_kernel(Int8Isa isa);
+
+    // q = clamp(round(x / scale) + zero_point, 0, activation_qmax)
+    void quantize_activations(const float* x, uint8_t* q, std::size_t n, float inv_scale, float zero_point);
+
+    inline std::size_t int8_padded(std::size_t k) {
+        return (k + int8_k_alignment - 1) / int8_k_alignment * int8_k_alignment;
+    }
+}
+
+#endif
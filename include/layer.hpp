@@ -2,110 +2,217 @@
 #define ___HPP__
 
 #include "common.hpp"
+#include "parameter.hpp"
+#include "sparse.hpp"
+#include "kernels/activation_kernels.hpp"
+#include "kernels/bf16.hpp"
 
 
+// Layers keep no per-batch state: the caller owns the activation and gradient
+// buffers (one pair per layer, see Workspace in model.hpp), writes them through
+// forward and hands the same buffers back to backward. backward adds the
+// parameter gradients of the batch to Parameter::gradient.
 class Layer {
 public:
-    xt::xarray<float> inputs;
-    xt::xarray<float> last_output;
-
     virtual ~Layer() = default;
 
-    virtual xt::xarray<float> forward(const xt::xarray<float>& inputs) = 0;
-    virtual xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) = 0;
+    // Width of the rows produced from rows of `input_size` features.
+    virtual std::size_t output_size(std::size_t input_size) const { return input_size; }
+
+    virtual void forward(const Matrix& inputs, Matrix& outputs) = 0;
+    virtual void backward(const Matrix& inputs, const Matrix& outputs,
+                          const Matrix& upstream_gradient, Matrix& downstream_gradient) = 0;
+
+    // Mixed precision: forward from bf16 inputs, rows padded to
+    // kernels::bf16_padded. Returns false for layers without a bf16 path,
+    // which are then run on fp32 inputs.
+    virtual bool forward_bf16(const Bf16Matrix& inputs, Matrix& outputs) { return false; }
+
+    // Sparse inputs, for the first layer: forward from CSR rows, then
+    // backward_sparse, which skips the input gradient. forward_sparse returns
+    // false for layers without a sparse path, which get the rows densified.
+    virtual bool forward_sparse(const CsrMatrix& inputs, Matrix& outputs) { return false; }
+    virtual void backward_sparse(const CsrMatrix& inputs, const Matrix& outputs, const Matrix& upstream_gradient) {
+        throw std::runtime_error("Layer: no sparse backward.");
+    }
+
+    // Whether forward may write its outputs over its inputs, which lets
+    // inference run the layer in place.
+    virtual bool in_place() const { return false; }
+
+    // Trainable tensors; backward accumulates into their gradients and the
+    // optimizer applies the update.
+    virtual std::vector<Parameter*> parameters() { return {}; }
+
+    // Floating point operations of one forward (or backward) pass over
+    // `rows` rows, for tracing. Elementwise layers count one per element.
+    virtual double flops(std::size_t rows, std::size_t input_size, bool backward) const {
+        return static_cast<double>(rows) * input_size;
+    }
+
+    // Same architecture with fresh parameters, for data-parallel workers.
+    // Layers without parameters hold no state and return nullptr: workers
+    // share the original.
+    virtual std::unique_ptr<Layer> replicate() const { return nullptr; }
 };
 
 class DenseLayer: public Layer {
+    // bf16 copy of the weights for forward_bf16, refreshed on every call
+    std::vector<kernels::bf16> weights_bf16;
+    kernels::Bf16GemmKernel bf16_gemm = kernels::bf16_gemm_kernel();
+
 public:
-    xt::xarray<float> weights;
-    xt::xarray<float> biases;
+    Parameter weights;  // (output_size, input_size)
+    Parameter biases;   // (1, output_size)
 
 public:
     DenseLayer(int input_size, int output_size);
-    DenseLayer(const xt::xarray<float>& weights, const xt::xarray<float>& biases);
+    DenseLayer(const Matrix& weights, const xt::xtensor<float, 1>& biases);
+
+    std::size_t output_size(std::size_t input_size) const override;
+    double flops(std::size_t rows, std::size_t input_size, bool backward) const override;
+    std::vector<Parameter*> parameters() override { return {&weights, &biases}; }
+    std::unique_ptr<Layer> replicate() const override;
+    void forward(const Matrix& inputs, Matrix& outputs) override;
+    bool forward_bf16(const Bf16Matrix& inputs, Matrix& outputs) override;
+    bool forward_sparse(const CsrMatrix& inputs, Matrix& outputs) override;
+    void backward(const Matrix& inputs, const Matrix& outputs,
+                  const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
+    void backward_sparse(const CsrMatrix& inputs, const Matrix& outputs, const Matrix& upstream_gradient) override;
+
+protected:
+    // Runs the GEMM by row tiles and applies `epilogue` (bias + activation) to
+    // each tile right after it is produced, while it is still in cache.
+    void forward_tiled(const Matrix& inputs, Matrix& outputs,
+                       const kernels::ActivationKernels& epilogue, float alpha) const;
+    // Same with a bf16 GEMM accumulating in fp32.
+    void forward_tiled_bf16(const Bf16Matrix& inputs, Matrix& outputs,
+                            const kernels::ActivationKernels& epilogue, float alpha);
+    // SpMM: each output reads the weights of the row's active features only.
+    void forward_csr(const CsrMatrix& inputs, Matrix& outputs,
+                     const kernels::ActivationKernels& epilogue, float alpha) const;
+    // Weight and bias gradients from the (rows, output_size) deltas, as
+    // sparse outer products: only the columns of active features are touched.
+    void accumulate_csr_gradients(const CsrMatrix& inputs, const float* delta);
+};
+
+// DenseLayer followed by an elementwise activation, fused: bias and activation
+// are the GEMM epilogue, and backward feeds dy * f'(z) tile by tile into the
+// weight and input gradient GEMMs. Only activations whose derivative can be
+// read back from their output are fusable, since z itself is never stored.
+class DenseActivation: public DenseLayer {
+    kernels::Activation kind;
+    const kernels::ActivationKernels* ops;
+    float alpha;
 
-    xt::xarray<float> forward(const xt::xarray<float>& inputs) override;
-    xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
+public:
+    DenseActivation(int input_size, int output_size, kernels::Activation kind, float alpha = 0.0f);
+    DenseActivation(DenseLayer&& dense, kernels::Activation kind, float alpha = 0.0f);
+
+    static bool fusable(kernels::Activation kind);
+
+    kernels::Activation activation() const { return kind; }
+    float parameter() const { return alpha; }
+
+    double flops(std::size_t rows, std::size_t input_size, bool backward) const override;
+    std::unique_ptr<Layer> replicate() const override;
+    void forward(const Matrix& inputs, Matrix& outputs) override;
+    bool forward_bf16(const Bf16Matrix& inputs, Matrix& outputs) override;
+    bool forward_sparse(const CsrMatrix& inputs, Matrix& outputs) override;
+    void backward(const Matrix& inputs, const Matrix& outputs,
+                  const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
+    void backward_sparse(const CsrMatrix& inputs, const Matrix& outputs, const Matrix& upstream_gradient) override;
 };
 
 namespace activation {
+    // Elementwise activations run the vectorized kernels selected for the host
+    // CPU; activation_function is the scalar reference of the same function.
     class BaseActivation: public Layer {
+    protected:
+        kernels::Activation activation_kind;
+        const kernels::ActivationKernels* ops;
+        float alpha;
+
     public:
+        BaseActivation(kernels::Activation kind = kernels::Activation::Identity, float alpha = 0.0f)
+            : activation_kind(kind), ops(&kernels::activation_kernels(kind)), alpha(alpha) {};
+
+        kernels::Activation kind() const { return activation_kind; }
+        float parameter() const { return alpha; }
+
         virtual float activation_function(float weighted_sum) {return weighted_sum;};
-        xt::xarray<float> forward(const xt::xarray<float>& inputs) {
-            auto vecf = xt::vectorize([this](float x) {
-                return this->activation_function(x);
-            });
-            this->inputs = inputs;
-            last_output = vecf(inputs);
-            return last_output;
+        bool in_place() const override { return true; }
+        void forward(const Matrix& inputs, Matrix& outputs) override {
+            ops->forward(inputs.data(), outputs.data(), inputs.size(), alpha);
+        };
+        void backward(const Matrix& inputs, const Matrix& outputs,
+                      const Matrix& upstream_gradient, Matrix& downstream_gradient) override {
+            ops->backward(inputs.data(), outputs.data(), upstream_gradient.data(),
+                          downstream_gradient.data(), inputs.size(), alpha);
         };
-        virtual xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) = 0;
     };
 
     class Sigmoid: public BaseActivation {
     public:
-        Sigmoid() = default;
+        Sigmoid() : BaseActivation(kernels::Activation::Sigmoid) {};
         ~Sigmoid() override = default;
         
         float activation_function(float weighted_sum) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
     };
 
     class Tanh: public BaseActivation {
     public:
-        Tanh() = default;
+        Tanh() : BaseActivation(kernels::Activation::Tanh) {};
         ~Tanh() override = default;
         
         float activation_function(float weighted_sum) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
     };
 
     class ReLU: public BaseActivation {
     public:
-        ReLU() = default;
+        ReLU() : BaseActivation(kernels::Activation::ReLU) {};
         ~ReLU() override = default;
         
         float activation_function(float weighted_sum) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
     };
 
     class LeakyReLU: public BaseActivation {
     public:
-        LeakyReLU() = default;
+        LeakyReLU() : BaseActivation(kernels::Activation::LeakyReLU, 0.01f) {};
         ~LeakyReLU() override = default;
         
         float activation_function(float weighted_sum) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
     };
 
     class ELU: public BaseActivation {
-        float alpha;
-    
     public:
-        ELU(float alpha) : alpha(alpha) {};
+        ELU(float alpha) : BaseActivation(kernels::Activation::ELU, alpha) {};
         ~ELU() override = default;
         
         float activation_function(float weighted_sum) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
     };
 
     class GELU: public BaseActivation {
     public:
-        GELU() = default;
+        GELU() : BaseActivation(kernels::Activation::GELU) {};
         ~GELU() override = default;
         
         float activation_function(float weighted_sum) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
     };
 
     class Softmax: public BaseActivation {
     public:
         Softmax() = default;
         ~Softmax() override = default;
-        
-        xt::xarray<float> forward(const xt::xarray<float>& inputs) override;
-        xt::xarray<float> backward(const xt::xarray<float>& upstream_gradient, float lr) override;
+
+        // exp, sum and divide forward; dot product and scale backward
+        double flops(std::size_t rows, std::size_t input_size, bool backward) const override {
+            return 3.0 * rows * input_size;
+        }
+
+        void forward(const Matrix& inputs, Matrix& outputs) override;
+        void backward(const Matrix& inputs, const Matrix& outputs,
+                      const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
     };
 }
 
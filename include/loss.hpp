@@ -5,25 +5,32 @@
 #include "common.hpp"
 
 namespace loss {
+    // `truth` holds one target per row; for classification losses it is the
+    // class index stored as float in column 0.
     class Loss {
     public:
-        virtual float forward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) = 0;
-        virtual xt::xarray<float> backward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) = 0;
+        virtual ~Loss() = default;
+        virtual float forward(const Matrix& predicted, const Matrix& truth) = 0;
+        virtual void backward(const Matrix& predicted, const Matrix& truth, Matrix& gradient) = 0;
     };
 
     class MSE: public Loss {
     public:
         MSE() = default;
-        float forward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) override;
-        xt::xarray<float> backward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) override;
+        float forward(const Matrix& predicted, const Matrix& truth) override;
+        void backward(const Matrix& predicted, const Matrix& truth, Matrix& gradient) override;
     };
 
     class CrossEntropy: public Loss {
     public:
         CrossEntropy() = default;
-        float forward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) override;
-        xt::xarray<float> backward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) override;
-        xt::xarray<float> backward_fused(const xt::xarray<float>& predicted, const xt::xarray<float>& truth);
+        float forward(const Matrix& predicted, const Matrix& truth) override;
+        void backward(const Matrix& predicted, const Matrix& truth, Matrix& gradient) override;
+
+        // Softmax + cross-entropy straight from the logits via log-sum-exp, in
+        // one pass per row: returns the mean loss and writes softmax - onehot.
+        float forward_backward_logits(const Matrix& logits, const Matrix& truth, Matrix& gradient);
+        float forward_logits(const Matrix& logits, const Matrix& truth);
     };
 }
 
@@ -1,10 +1,21 @@
 #ifndef __MODEL_HPP__
 #define __MODEL_HPP__
 
+#include "checkpoint.hpp"
 #include "common.hpp"
+#include "conv_layer.hpp"
 #include "layer.hpp"
 #include "loss.hpp"
+#include "optimizer.hpp"
+#include "predictor.hpp"
+#include "quantization.hpp"
+#include "workspace.hpp"
 #include "utils/dataloader.hpp"
+#include "utils/prefetcher.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/tracer.hpp"
+#include <atomic>
+#include <typeinfo>
 
 
 struct EpochResult {
@@ -12,10 +23,34 @@ struct EpochResult {
     float train_loss;
     float val_loss;
     float val_accuracy;
+    // time the training loop waited for batches, with prefetching enabled
+    float data_stall_s;
+    // time the prefetcher waited for a free slot
+    float data_backpressure_s;
+    // per-operation timings of the epoch, empty unless tracing
+    TraceSummary trace;
 };
 
 using EpochEndCallback = std::function<void(const EpochResult&)>;
 
+struct QuantizationReport {
+    std::size_t float_weight_bytes = 0;
+    std::size_t int8_weight_bytes = 0;
+};
+
+// One data-parallel worker: a fixed shard of every training micro-batch,
+// with its own activations and gradients. Worker 0 runs the model's own
+// layers; the others run replicas whose values alias the model's parameter arena.
+struct Worker {
+    std::vector<std::unique_ptr<Layer>> replicas;
+    std::vector<Layer*> layers;
+    ParameterArena gradients;   // unused by worker 0, which accumulates into the model's arena
+    Workspace workspace;
+    std::size_t shard_offset = 0;
+    std::size_t shard_size = 0;
+    float loss = 0.0f;          // summed over the samples of the batch
+};
+
 
 class Model {
 	std::vector<std::unique_ptr<Layer>> layers;
@@ -25,6 +60,34 @@ class Model {
 	int epochs;
 	EpochEndCallback on_epoch_end_callback;
     bool softmax_cross_entropy = false;
+    Workspace val_workspace;
+    ParameterArena parameters;
+    std::unique_ptr<optim::Optimizer> optimizer = std::make_unique<optim::SGD>();
+    bool parameters_bound = false;
+    int n_threads = 1;
+    std::vector<Worker> workers;
+    std::unique_ptr<WorkerPool> pool;
+    std::size_t prefetch_depth = 0;
+    std::size_t accumulation_steps = 1;
+    std::size_t recompute_segment = 1;
+    std::size_t activation_budget = 0;
+    std::unique_ptr<Prefetcher> prefetcher;
+    std::vector<std::size_t> epoch_order;
+    std::size_t predict_max_batch_size = 32;
+    std::chrono::microseconds predict_max_delay{200};
+    std::unique_ptr<Predictor> predictor;
+    std::mutex predictor_mutex;
+    int checkpoint_every = 1;
+    std::unique_ptr<checkpoint::AsyncWriter> checkpoint_writer;
+    std::vector<char> checkpoint_buffer;
+    int start_epoch = 0;
+    float resume_lr = 0.0f;    // 0 unless resuming from a checkpoint
+    Tracer tracer;
+    std::string trace_path;
+    bool mixed_precision = false;
+    bool no_grad_inference = true;
+    bool show_progress = true;
+    std::atomic<bool> stop_requested = false;
 
 public:
 	Model(std::unique_ptr<loss::Loss> loss, float lr, float weight_decay, int epochs, EpochEndCallback on_epoch_end_callback = nullptr)
@@ -37,17 +100,166 @@ public:
 	}
 
 	void addLayer(std::unique_ptr<Layer> p_layer) {
+        parameters_bound = false;
+
+        // a DenseLayer directly followed by a fusable activation becomes one DenseActivation
+        auto activation_layer = dynamic_cast<activation::BaseActivation*>(p_layer.get());
+        if (activation_layer && !layers.empty() && typeid(*layers.back()) == typeid(DenseLayer)
+            && DenseActivation::fusable(activation_layer->kind())) {
+            auto dense = static_cast<DenseLayer*>(layers.back().get());
+            layers.back() = std::make_unique<DenseActivation>(
+                std::move(*dense), activation_layer->kind(), activation_layer->parameter());
+            softmax_cross_entropy = false;
+            return;
+        }
+
 		layers.push_back(std::move(p_layer));
         auto softmax_layer = dynamic_cast<activation::Softmax*>(layers.back().get());
         auto cross_entropy_loss = dynamic_cast<loss::CrossEntropy*>(loss.get());
         softmax_cross_entropy = (softmax_layer && cross_entropy_loss);
 	}
 
+	void setOptimizer(std::unique_ptr<optim::Optimizer> p_optimizer) {
+        optimizer = std::move(p_optimizer);
+	}
+
+	// Draws a progress bar on stdout through every epoch; on by default.
+	void setProgress(bool enabled) {
+        show_progress = enabled;
+	}
+
+	// Ends train() once the current epoch is done, e.g. from the epoch-end
+	// callback to stop early. Safe to call from any thread.
+	void stopTraining() {
+        stop_requested = true;
+	}
+
+	// Number of threads each training batch is sharded across.
+	void setThreads(int threads) {
+        if (threads < 1) {
+            throw std::runtime_error("Model: the number of threads must be >= 1.");
+        }
+        n_threads = threads;
+	}
+
+	// Splits every training batch into `steps` micro-batches run one after
+	// the other, their gradients summed before a single optimizer step:
+	// the update of the full batch with the activation memory of a
+	// micro-batch. The batch size must be a multiple of `steps`.
+	void setGradAccumulation(std::size_t steps) {
+        if (steps < 1) {
+            throw std::runtime_error("Model: the number of accumulation steps must be >= 1.");
+        }
+        accumulation_steps = steps;
+	}
+
+	// Keeps only the input of every `layers`-th layer during training and
+	// runs the layers in between again, one segment at a time, as backward
+	// reaches them: up to one extra forward pass, for activations of about
+	// n / layers + layers layers instead of n. 1 keeps every activation.
+	void setRecomputeSegment(std::size_t layers) {
+        if (layers < 1) {
+            throw std::runtime_error("Model: the recompute segment must be >= 1 layer.");
+        }
+        recompute_segment = layers;
+	}
+
+	// Takes the shortest recompute segment whose training activations and
+	// gradients, over all workers, fit in `bytes`; overrides
+	// setRecomputeSegment. 0 turns the budget off.
+	void setActivationBudget(std::size_t bytes) {
+        activation_budget = bytes;
+	}
+
+	// Number of batches prepared ahead by a background thread; 0 loads
+	// each batch on the training thread.
+	void setPrefetch(std::size_t depth) {
+        prefetch_depth = depth;
+	}
+
+	// Times every layer's forward and backward, the loss, the data loading,
+	// the gradient reduction and the optimizer during training. A summary
+	// comes with each EpochResult; with a path, the whole trace is written
+	// there as Chrome trace_event JSON when training ends.
+	void setTracing(bool enabled, const std::string& path = "");
+
+	// Trains with activations stored in bf16 and bf16 forward GEMMs that
+	// accumulate in fp32; parameters, their gradients and the optimizer
+	// stay fp32. Evaluation and inference are unaffected.
+	void setMixedPrecision(bool enabled) {
+        mixed_precision = enabled;
+	}
+
+	// Trainable values over all layers.
+	std::size_t parameterCount();
+
+	// Activation and gradient memory of the training workers, once train() has set them up.
+	std::size_t workspaceBytes() const;
+
+	// Evaluation and predict() keep no activation for a backward pass and
+	// no gradients: two buffers per layer width, reused down the network,
+	// with elementwise layers writing over their inputs. On by default; off
+	// runs them on the training layout.
+	void setNoGradInference(bool enabled) {
+        no_grad_inference = enabled;
+	}
+
+	// Activation memory of the last evaluate().
+	std::size_t evaluationBytes() const {
+        return val_workspace.bytes();
+	}
+
+	// Saves a checkpoint to `path` every `every_epochs` epochs during
+	// training, on a background thread. An empty path disables it.
+	void setCheckpoint(const std::string& path, int every_epochs = 1);
+
+	// Maps the parameters of a checkpoint in place and restores the
+	// optimizer state, so train() resumes after its last epoch with its
+	// learning rate. Builds the layers when the model has none; otherwise
+	// they must match the checkpoint's graph.
+	void loadCheckpoint(const std::string& path);
+
 	void train(Dataloader& train_dataloader, Dataloader& val_dataloader);
 
+	// Mean loss and accuracy over the batches of `dataloader`.
+	std::tuple<float, float> evaluate(const Dataloader& dataloader);
+
+	// Replaces the dense layers by int8 QuantizedDenseLayers, with activation
+	// ranges calibrated on up to `max_batches` batches of `calibration`. The
+	// model can only run inference afterwards.
+	QuantizationReport quantize(const Dataloader& calibration, unsigned int max_batches = 16);
+
+	// Online inference, safe to call from any number of threads (but not
+	// while training). Samples are coalesced into micro-batches of up to
+	// `max_batch_size`, waiting at most `max_delay` for a batch to fill;
+	// the future holds the model's output row for the sample.
+	void setBatching(std::size_t max_batch_size, std::chrono::microseconds max_delay);
+	std::future<std::vector<float>> predict(std::vector<float> features);
+	PredictionStats predictionStats();
+
 private:
-    float train_step(xt::xarray<float>& inputs, xt::xarray<float>& truths, float dynamic_lr);
-    std::tuple<float, unsigned int> validation_step(xt::xarray<float>& inputs, xt::xarray<float>& truths);
+    void bind_parameters();
+    std::vector<Parameter*> all_parameters();
+    void save_checkpoint(int epoch, float dynamic_lr);
+    // Sparse inputs leave activations[0] and gradients[0] empty.
+    void reserve(Workspace& workspace, std::size_t batch_size, std::size_t input_size,
+                 WorkspaceKind kind = WorkspaceKind::Training, bool sparse = false, std::size_t segment = 1);
+    std::size_t recompute_segment_for(std::size_t batch_size, std::size_t input_size, bool sparse);
+    void setup_workers(std::size_t batch_size, std::size_t input_size, bool sparse);
+    ParameterArena& worker_arena(std::size_t index) { return index == 0 ? parameters : workers[index].gradients; }
+    void reduce_gradients();
+    const Matrix& forward(Workspace& workspace);
+    // With sparse_inputs, `inputs` is unused and the first layer reads the CSR rows.
+    float forward_backward(const std::vector<Layer*>& worker_layers, const Matrix& inputs, const CsrMatrix* sparse_inputs,
+                           const Matrix& truths, Workspace& workspace, Tracer::Lane* lane);
+    float forward_backward_mixed(const std::vector<Layer*>& worker_layers, const Matrix& inputs,
+                                 const Matrix& truths, Workspace& workspace, Tracer::Lane* lane);
+    void configure_tracer();
+    Tracer::Lane* trace_lane(std::size_t worker) {
+        return tracing_compiled && tracer.enabled ? &tracer.lane(worker) : nullptr;
+    }
+    float train_step(const Dataloader& dataloader, const std::size_t* batch_indices, const Prefetcher::Slot* slot, float dynamic_lr);
+    std::tuple<float, unsigned int> validation_step(Workspace& workspace, bool sparse);
 };
 
 class ProgressBar {
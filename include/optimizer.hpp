@@ -0,0 +1,70 @@
+#ifndef __OPTIMIZER_HPP__
+#define __OPTIMIZER_HPP__
+
+#include "parameter.hpp"
+
+namespace optim {
+    // Updates the whole arena in one fused pass. Gradients are sums over the
+    // batch; grad_scale (1 / samples) turns them into means on the fly.
+    class Optimizer {
+    public:
+        virtual ~Optimizer() = default;
+        virtual void step(ParameterArena& arena, float lr, float grad_scale) = 0;
+
+        // Per-parameter state for checkpoints: buffers of `size` floats,
+        // allocated if needed, and the number of steps taken.
+        virtual std::vector<float*> state(std::size_t size) { return {}; }
+        virtual long steps() const { return 0; }
+        virtual void set_steps(long steps) {}
+
+    protected:
+        // (Re)allocates per-parameter state when the arena layout changes.
+        static void ensure_state(AlignedBuffer& state, std::size_t state_size, std::size_t size);
+    };
+
+    // Plain SGD when momentum is 0, heavy-ball or Nesterov momentum otherwise.
+    class SGD: public Optimizer {
+        float momentum;
+        bool nesterov;
+        AlignedBuffer velocity;
+        std::size_t state_size = 0;
+
+    public:
+        SGD(float momentum = 0.0f, bool nesterov = false) : momentum(momentum), nesterov(nesterov) {};
+        void step(ParameterArena& arena, float lr, float grad_scale) override;
+        std::vector<float*> state(std::size_t size) override;
+    };
+
+    class Adam: public Optimizer {
+        float beta1;
+        float beta2;
+        float epsilon;
+        long t = 0;
+        AlignedBuffer first_moment;
+        AlignedBuffer second_moment;
+        std::size_t state_size = 0;
+
+    protected:
+        // decoupled (AdamW) decay, applied as w *= 1 - lr * weight_decay
+        float weight_decay = 0.0f;
+
+    public:
+        Adam(float beta1 = 0.9f, float beta2 = 0.999f, float epsilon = 1e-8f)
+            : beta1(beta1), beta2(beta2), epsilon(epsilon) {};
+        void step(ParameterArena& arena, float lr, float grad_scale) override;
+        std::vector<float*> state(std::size_t size) override;
+        long steps() const override { return t; }
+        void set_steps(long steps) override { t = steps; }
+    };
+
+    class AdamW: public Adam {
+    public:
+        AdamW(float weight_decay = 1e-2f, float beta1 = 0.9f, float beta2 = 0.999f, float epsilon = 1e-8f)
+            : Adam(beta1, beta2, epsilon) { this->weight_decay = weight_decay; };
+    };
+
+    // Builds the optimizer named by config["optimizer"]: sgd, nesterov, adam or adamw.
+    std::unique_ptr<Optimizer> make_optimizer(const nlohmann::json& config);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef __PARAMETER_HPP__
+#define __PARAMETER_HPP__
+
+#include "common.hpp"
+#include <cstdlib>
+#include <memory>
+
+constexpr std::size_t arena_alignment = 64;
+
+struct AlignedDeleter {
+    void operator()(float* p) const { std::free(p); }
+};
+using AlignedBuffer = std::unique_ptr<float[], AlignedDeleter>;
+
+// Zero-filled buffer of `count` floats aligned on arena_alignment bytes.
+AlignedBuffer make_aligned_buffer(std::size_t count);
+
+// A trainable (rows, cols) tensor and its gradient. It owns its storage until
+// Model binds it into the shared ParameterArena; after that value and
+// gradient point into the arena.
+class Parameter {
+    std::vector<float> storage;
+
+public:
+    std::size_t rows;
+    std::size_t cols;
+    float* value;
+    float* gradient;
+
+    Parameter(std::size_t rows, std::size_t cols);
+    Parameter(Parameter&&) = default;
+    Parameter& operator=(Parameter&&) = default;
+    Parameter(const Parameter&) = delete;
+    Parameter& operator=(const Parameter&) = delete;
+
+    std::size_t size() const { return rows * cols; }
+
+    // Non-owning xtensor views, valid as long as the parameter stays bound.
+    auto values() { return xt::adapt(value, size(), xt::no_ownership(), std::array<std::size_t, 2>{rows, cols}); }
+    auto values() const { return xt::adapt(static_cast<const float*>(value), size(), xt::no_ownership(), std::array<std::size_t, 2>{rows, cols}); }
+    auto gradients() { return xt::adapt(gradient, size(), xt::no_ownership(), std::array<std::size_t, 2>{rows, cols}); }
+
+    // Copies the current value into the slots and points the parameter at them.
+    void bind(float* value_slot, float* gradient_slot);
+    // Points the parameter at slots owned by someone else, without copying.
+    void share(float* value_slot, float* gradient_slot);
+};
+
+// Every parameter and gradient of a model in two flat, aligned buffers, so
+// optimizers and reductions run one pass over the whole model. Each
+// parameter starts on an arena_alignment boundary; padding stays zero.
+class ParameterArena {
+    AlignedBuffer value_buffer;     // empty when the values belong to another arena
+    AlignedBuffer gradient_buffer;
+    std::shared_ptr<void> value_owner;  // keeps external values alive, e.g. a mapped checkpoint
+    float* value_data = nullptr;
+    std::size_t count = 0;
+
+public:
+    void bind(const std::vector<Parameter*>& parameters);
+    // Binds the parameters of a model replica onto the values of `master`,
+    // with a private gradient buffer. Both lists must have the same layout.
+    void bind_shared(const std::vector<Parameter*>& parameters, ParameterArena& master);
+    // Binds the parameters onto `size` aligned values laid out like bind()
+    // would, without copying them. `owner` is held as long as the arena.
+    void bind_external(const std::vector<Parameter*>& parameters, float* values, std::size_t size,
+                       std::shared_ptr<void> owner);
+
+    static std::size_t padded_size(std::size_t size);
+
+    float* values() { return value_data; }
+    float* gradients() { return gradient_buffer.get(); }
+    std::size_t size() const { return count; }
+
+    void zero_gradients();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef __PREDICTOR_HPP__
+#define __PREDICTOR_HPP__
+
+#include "workspace.hpp"
+#include "utils/histogram.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+struct PredictionStats {
+    std::size_t requests = 0;
+    std::size_t batches = 0;
+    // submit-to-result latency, in microseconds
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double mean_batch_size = 0.0;
+    // batch_fill[n] = number of batches that held n requests
+    std::vector<std::size_t> batch_fill;
+};
+
+// Dynamic micro-batching for online inference. Any number of threads submit
+// single samples; one dispatcher thread coalesces them into a batch once
+// max_batch_size requests are queued or the oldest one has waited max_delay,
+// runs one forward pass and fulfils each request's future with its row.
+// Batches are padded up to a power of two so a handful of workspaces, sized
+// once, serve every batch size.
+class Predictor {
+public:
+    // Sizes a workspace for `rows` samples of `input_size` features.
+    using Prepare = std::function<void(Workspace& workspace, std::size_t rows, std::size_t input_size)>;
+    // Runs the forward pass on workspace.activations[0] and returns the outputs.
+    using Run = std::function<const Matrix&(Workspace& workspace)>;
+
+    Predictor(Prepare prepare, Run run, std::size_t max_batch_size, std::chrono::microseconds max_delay);
+    ~Predictor();
+
+    Predictor(const Predictor&) = delete;
+    Predictor& operator=(const Predictor&) = delete;
+
+    std::future<std::vector<float>> submit(std::vector<float> features);
+
+    PredictionStats stats() const;
+    void reset_stats();
+
+private:
+    struct Request {
+        std::vector<float> features;
+        std::promise<std::vector<float>> promise;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    Prepare prepare;
+    Run run;
+    std::size_t max_batch_size;
+    std::chrono::microseconds max_delay;
+    std::size_t input_size = 0;    // set by the first request, all others must match
+
+    std::mutex mutex;
+    std::condition_variable queue_cv;
+    std::deque<Request> queue;
+    bool stopping = false;
+
+    mutable std::mutex stats_mutex;
+    LatencyHistogram latency;
+    std::vector<std::size_t> batch_fill;
+
+    // one per power-of-two batch size, only touched by the dispatcher
+    std::vector<Workspace> workspaces;
+    std::thread dispatcher;
+
+    void dispatch();
+    void run_batch(std::vector<Request>& batch);
+};
+
+#endif
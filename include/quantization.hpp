@@ -0,0 +1,63 @@
+#ifndef __QUANTIZATION_HPP__
+#define __QUANTIZATION_HPP__
+
+#include "layer.hpp"
+#include "kernels/int8_gemm.hpp"
+#include <limits>
+
+// Affine map between floats and quantized activations: x ~ scale * (q - zero_point),
+// q in [0, kernels::activation_qmax].
+struct QuantizationParams {
+    float scale = 1.0f;
+    float zero_point = 0.0f;
+
+    static QuantizationParams from_range(float min, float max);
+};
+
+// Smallest and largest value seen at a layer input during calibration.
+struct ActivationRange {
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+
+    void observe(const float* values, std::size_t n);
+};
+
+// Post-training int8 version of one or more consecutive dense layers, for
+// inference only. Weights are int8 with one scale per output channel, inputs
+// are quantized with the range calibrated for them, and products accumulate
+// in int32. Each stage's epilogue dequantizes, adds the bias and applies the
+// activation in one pass; between stages it requantizes straight into the
+// next stage's int8 input, so only the first input and last output are floats.
+class QuantizedDenseLayer: public Layer {
+    struct Int8Deleter {
+        void operator()(int8_t* p) const { std::free(p); }
+    };
+
+    struct Stage {
+        std::size_t input_size;
+        std::size_t output_size;
+        std::size_t k_padded;
+        std::unique_ptr<int8_t[], Int8Deleter> weights;     // (output_size, k_padded), zero padded
+        std::vector<float> output_scales;   // input scale * weight scale of each channel
+        std::vector<float> biases;          // bias minus the input zero-point correction
+        QuantizationParams input;
+        const kernels::ActivationKernels* ops;
+        float alpha;
+    };
+
+    std::vector<Stage> stages;
+    kernels::Int8GemmKernel gemm = kernels::int8_gemm_kernel();
+
+public:
+    // Appends `dense` followed by `kind`, whose inputs were observed in `input_range`.
+    void add_stage(const DenseLayer& dense, kernels::Activation kind, float alpha, const ActivationRange& input_range);
+
+    std::size_t weight_bytes() const;
+
+    std::size_t output_size(std::size_t input_size) const override;
+    void forward(const Matrix& inputs, Matrix& outputs) override;
+    void backward(const Matrix& inputs, const Matrix& outputs,
+                  const Matrix& upstream_gradient, Matrix& downstream_gradient) override;
+};
+
+#endif
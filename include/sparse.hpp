@@ -0,0 +1,77 @@
+#ifndef __SPARSE_HPP__
+#define __SPARSE_HPP__
+
+#include "common.hpp"
+#include <cstdint>
+
+// Compressed sparse rows, for inputs that are mostly zeros (bag-of-words,
+// one-hot categories). The non-zeros of row i are values[k] at column
+// columns[k] for k in [row_offsets[i], row_offsets[i + 1]), columns ascending.
+// clear() keeps the capacity, so a batch refilled every step stops allocating.
+struct CsrMatrix {
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::vector<std::size_t> row_offsets{0};
+    std::vector<uint32_t> columns;
+    std::vector<float> values;
+
+    std::size_t nnz() const { return values.size(); }
+
+    void clear(std::size_t n_cols) {
+        rows = 0;
+        cols = n_cols;
+        row_offsets.assign(1, 0);
+        columns.clear();
+        values.clear();
+    }
+
+    void append_row(const uint32_t* row_columns, const float* row_values, std::size_t count) {
+        columns.insert(columns.end(), row_columns, row_columns + count);
+        values.insert(values.end(), row_values, row_values + count);
+        row_offsets.push_back(values.size());
+        rows++;
+    }
+
+    // Appends row i of `other`.
+    void append_row(const CsrMatrix& other, std::size_t i) {
+        std::size_t first = other.row_offsets[i];
+        append_row(other.columns.data() + first, other.values.data() + first, other.row_offsets[i + 1] - first);
+    }
+
+    // Writes the rows densely into (rows, cols) floats.
+    void to_dense(float* out) const {
+        std::fill_n(out, rows * cols, 0.0f);
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t k = row_offsets[i]; k < row_offsets[i + 1]; k++) {
+                out[i * cols + columns[k]] = values[k];
+            }
+        }
+    }
+
+    static CsrMatrix from_dense(const float* x, std::size_t rows, std::size_t cols) {
+        CsrMatrix result;
+        result.clear(cols);
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t j = 0; j < cols; j++) {
+                if (x[i * cols + j] != 0.0f) {
+                    result.columns.push_back(static_cast<uint32_t>(j));
+                    result.values.push_back(x[i * cols + j]);
+                }
+            }
+            result.row_offsets.push_back(result.values.size());
+        }
+        result.rows = rows;
+        return result;
+    }
+
+    CsrMatrix select_rows(const std::vector<std::size_t>& indices) const {
+        CsrMatrix result;
+        result.clear(cols);
+        for (auto i : indices) {
+            result.append_row(*this, i);
+        }
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef __STATIC_MODEL_HPP__
+#define __STATIC_MODEL_HPP__
+
+#include "model.hpp"
+#include <array>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <utility>
+
+// Layers of a StaticModel. Widths are template arguments, so every buffer is
+// a std::array and every loop has a constant trip count the compiler unrolls.
+// A layer maps a std::array<float, N> to another; backward adds its
+// parameter gradients and, when InputGradient, writes the input gradient.
+namespace fixed {
+    template <std::size_t In, std::size_t Out>
+    struct Dense {
+        static constexpr std::size_t input_width = In;
+        static constexpr bool is_softmax = false;
+        static constexpr std::size_t output_width(std::size_t) { return Out; }
+
+        std::array<float, Out * In> weights;    // (Out, In), row-major like DenseLayer
+        std::array<float, Out> biases{};
+        std::array<float, Out * In> weights_gradient{};
+        std::array<float, Out> biases_gradient{};
+
+        Dense() {
+            // same initialization as DenseLayer, from the same engine
+            std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+            for (auto& w : weights) {
+                w = uniform(xt::random::get_default_random_engine());
+            }
+        }
+
+        template <std::size_t N>
+        void forward(const std::array<float, N>& x, std::array<float, Out>& y) const {
+            static_assert(N == In, "Dense input width does not match the previous layer");
+            for (std::size_t o = 0; o < Out; o++) {
+                float sum = biases[o];
+                for (std::size_t i = 0; i < In; i++) {
+                    sum += weights[o * In + i] * x[i];
+                }
+                y[o] = sum;
+            }
+        }
+
+        template <bool InputGradient, std::size_t N>
+        void backward(const std::array<float, N>& x, const std::array<float, Out>&,
+                      const std::array<float, Out>& dy, std::array<float, N>& dx) {
+            for (std::size_t o = 0; o < Out; o++) {
+                biases_gradient[o] += dy[o];
+                for (std::size_t i = 0; i < In; i++) {
+                    weights_gradient[o * In + i] += dy[o] * x[i];
+                }
+            }
+            if constexpr (InputGradient) {
+                dx.fill(0.0f);
+                for (std::size_t o = 0; o < Out; o++) {
+                    for (std::size_t i = 0; i < In; i++) {
+                        dx[i] += weights[o * In + i] * dy[o];
+                    }
+                }
+            }
+        }
+
+        // Plain SGD on the summed gradients, which are cleared for the next batch.
+        void step(float step_size) {
+            for (std::size_t k = 0; k < weights.size(); k++) {
+                weights[k] -= step_size * weights_gradient[k];
+            }
+            for (std::size_t o = 0; o < Out; o++) {
+                biases[o] -= step_size * biases_gradient[o];
+            }
+            weights_gradient.fill(0.0f);
+            biases_gradient.fill(0.0f);
+        }
+    };
+
+    // y = F::value(x) and dx = dy * F::derivative(x, y), element by element.
+    template <class F>
+    struct Elementwise {
+        static constexpr bool is_softmax = false;
+        static constexpr std::size_t output_width(std::size_t input_width) { return input_width; }
+
+        template <std::size_t N>
+        void forward(const std::array<float, N>& x, std::array<float, N>& y) const {
+            for (std::size_t i = 0; i < N; i++) {
+                y[i] = F::value(x[i]);
+            }
+        }
+
+        template <bool InputGradient, std::size_t N>
+        void backward(const std::array<float, N>& x, const std::array<float, N>& y,
+                      const std::array<float, N>& dy, std::array<float, N>& dx) {
+            if constexpr (InputGradient) {
+                for (std::size_t i = 0; i < N; i++) {
+                    dx[i] = dy[i] * F::derivative(x[i], y[i]);
+                }
+            }
+        }
+
+        void step(float) {}
+    };
+
+    struct ReLU: Elementwise<ReLU> {
+        static float value(float x) { return x > 0.0f ? x : 0.0f; }
+        static float derivative(float x, float) { return x > 0.0f ? 1.0f : 0.0f; }
+    };
+
+    struct LeakyReLU: Elementwise<LeakyReLU> {
+        static float value(float x) { return x > 0.0f ? x : 0.01f * x; }
+        static float derivative(float x, float) { return x > 0.0f ? 1.0f : 0.01f; }
+    };
+
+    struct Sigmoid: Elementwise<Sigmoid> {
+        static float value(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+        static float derivative(float, float y) { return y * (1.0f - y); }
+    };
+
+    struct Tanh: Elementwise<Tanh> {
+        static float value(float x) { return std::tanh(x); }
+        static float derivative(float, float y) { return 1.0f - y * y; }
+    };
+
+    struct Softmax {
+        static constexpr bool is_softmax = true;
+        static constexpr std::size_t output_width(std::size_t input_width) { return input_width; }
+
+        template <std::size_t N>
+        void forward(const std::array<float, N>& x, std::array<float, N>& y) const {
+            float max = x[0];
+            for (std::size_t i = 1; i < N; i++) {
+                max = std::max(max, x[i]);
+            }
+            float sum = 0.0f;
+            for (std::size_t i = 0; i < N; i++) {
+                y[i] = std::exp(x[i] - max);
+                sum += y[i];
+            }
+            float inv_sum = 1.0f / sum;
+            for (std::size_t i = 0; i < N; i++) {
+                y[i] *= inv_sum;
+            }
+        }
+
+        template <bool InputGradient, std::size_t N>
+        void backward(const std::array<float, N>&, const std::array<float, N>& y,
+                      const std::array<float, N>& dy, std::array<float, N>& dx) {
+            if constexpr (InputGradient) {
+                float dot = 0.0f;
+                for (std::size_t i = 0; i < N; i++) {
+                    dot += dy[i] * y[i];
+                }
+                for (std::size_t i = 0; i < N; i++) {
+                    dx[i] = y[i] * (dy[i] - dot);
+                }
+            }
+        }
+
+        void step(float) {}
+    };
+}
+
+// Model for small topologies fixed at compile time, e.g.
+// StaticModel<fixed::Dense<4, 16>, fixed::ReLU, fixed::Dense<16, 3>, fixed::Softmax>.
+// Samples run one at a time through std::array buffers with every layer
+// inlined: no virtual call, no shape bookkeeping and no allocation after
+// the first batch. The loss still sees the whole batch as a Matrix, through
+// the same loss::Loss as Model (one virtual call per batch), and training
+// reports to the same EpochEndCallback. Parameters are updated with SGD and
+// Model's learning rate decay.
+template <class... Layers>
+class StaticModel {
+    static constexpr std::size_t n_layers = sizeof...(Layers);
+    using LayerTuple = std::tuple<Layers...>;
+    using First = std::tuple_element_t<0, LayerTuple>;
+    using Last = std::tuple_element_t<n_layers - 1, LayerTuple>;
+
+    static constexpr std::array<std::size_t, n_layers + 1> widths = [] {
+        std::array<std::size_t, n_layers + 1> result{};
+        result[0] = First::input_width;
+        std::size_t i = 0;
+        ((result[i + 1] = Layers::output_width(result[i]), i++), ...);
+        return result;
+    }();
+
+    template <std::size_t... I>
+    static auto buffers_of(std::index_sequence<I...>) -> std::tuple<std::array<float, widths[I]>...>;
+    // the input and the output of every layer for one sample
+    using Buffers = decltype(buffers_of(std::make_index_sequence<n_layers + 1>()));
+
+public:
+    static constexpr std::size_t input_size = widths.front();
+    static constexpr std::size_t output_size = widths.back();
+    using Input = std::array<float, input_size>;
+    using Output = std::array<float, output_size>;
+
+    StaticModel(std::unique_ptr<loss::Loss> loss, float lr, float weight_decay, int epochs, EpochEndCallback on_epoch_end_callback = nullptr)
+        : loss(std::move(loss)), lr(lr), weight_decay(weight_decay), epochs(epochs),
+          on_epoch_end_callback(std::move(on_epoch_end_callback))
+    {
+        softmax_cross_entropy = Last::is_softmax && dynamic_cast<loss::CrossEntropy*>(this->loss.get());
+    }
+
+    template <std::size_t I>
+    auto& layer() { return std::get<I>(layers); }
+
+    void train(Dataloader& train_dataloader, Dataloader& val_dataloader) {
+        check_input(train_dataloader);
+        float dynamic_lr = lr;
+        for (int epoch = 0; epoch < epochs; epoch++) {
+            train_dataloader.epoch_indices(epoch, order);
+            float train_err = 0.0f;
+            for (unsigned int batch = 0; batch < train_dataloader.n_batches; batch++) {
+                train_dataloader.gather(order.data() + static_cast<std::size_t>(batch) * train_dataloader.batch_size,
+                                        train_dataloader.batch_size, x_batch, y_batch);
+                float step_size = dynamic_lr / train_dataloader.batch_size;
+                train_err += softmax_cross_entropy ? train_batch<logits_index()>(step_size) : train_batch<n_layers>(step_size);
+            }
+
+            dynamic_lr = lr * std::exp(-weight_decay * epoch);
+            auto [val_err, val_accuracy] = evaluate(val_dataloader);
+            if (on_epoch_end_callback) {
+                on_epoch_end_callback(EpochResult{
+                    .epoch = epoch,
+                    .train_loss = train_err / train_dataloader.n_batches,
+                    .val_loss = val_err,
+                    .val_accuracy = val_accuracy,
+                    .data_stall_s = 0.0f,
+                    .data_backpressure_s = 0.0f,
+                });
+            }
+        }
+    }
+
+    // Mean loss and accuracy over the batches of `dataloader`.
+    std::tuple<float, float> evaluate(const Dataloader& dataloader) {
+        check_input(dataloader);
+        return softmax_cross_entropy ? evaluate<logits_index()>(dataloader) : evaluate<n_layers>(dataloader);
+    }
+
+    Output predict(const Input& features) const {
+        Buffers buffers;
+        std::get<0>(buffers) = features;
+        forward<n_layers>(buffers);
+        return std::get<n_layers>(buffers);
+    }
+
+private:
+    LayerTuple layers;
+    std::unique_ptr<loss::Loss> loss;
+    float lr;
+    float weight_decay;
+    int epochs;
+    EpochEndCallback on_epoch_end_callback;
+    // the Softmax is folded into the loss, which takes the logits
+    bool softmax_cross_entropy = false;
+
+    std::vector<Buffers> batch_buffers;
+    Matrix x_batch;
+    Matrix y_batch;
+    Matrix outputs;
+    Matrix output_gradient;
+    std::vector<std::size_t> order;
+
+    // output of the last layer before a final Softmax
+    static constexpr std::size_t logits_index() { return Last::is_softmax ? n_layers - 1 : n_layers; }
+
+    static void check_input(const Dataloader& dataloader) {
+        if (dataloader.n_features != input_size) {
+            throw std::runtime_error("StaticModel expects " + std::to_string(input_size)
+                                     + " input features, got " + std::to_string(dataloader.n_features) + ".");
+        }
+    }
+
+    // Runs layers [I, Stop) of one sample.
+    template <std::size_t Stop, std::size_t I = 0>
+    void forward(Buffers& buffers) const {
+        if constexpr (I < Stop) {
+            std::get<I>(layers).forward(std::get<I>(buffers), std::get<I + 1>(buffers));
+            forward<Stop, I + 1>(buffers);
+        }
+    }
+
+    // Backpropagates gradients[I] through layers [0, I); the network input needs no gradient.
+    template <std::size_t I>
+    void backward(const Buffers& buffers, Buffers& gradients) {
+        if constexpr (I > 0) {
+            std::get<I - 1>(layers).template backward<(I > 1)>(
+                std::get<I - 1>(buffers), std::get<I>(buffers), std::get<I>(gradients), std::get<I - 1>(gradients));
+            backward<I - 1>(buffers, gradients);
+        }
+    }
+
+    // Forwards every row of x_batch up to layer Stop into `outputs`.
+    template <std::size_t Stop>
+    void forward_batch() {
+        std::size_t rows = x_batch.shape()[0];
+        batch_buffers.resize(rows);
+        outputs.resize({rows, widths[Stop]});
+        for (std::size_t r = 0; r < rows; r++) {
+            auto& input = std::get<0>(batch_buffers[r]);
+            std::copy_n(x_batch.data() + r * input_size, input_size, input.data());
+            forward<Stop>(batch_buffers[r]);
+            const auto& output = std::get<Stop>(batch_buffers[r]);
+            std::copy(output.begin(), output.end(), outputs.data() + r * widths[Stop]);
+        }
+    }
+
+    template <std::size_t Stop>
+    float train_batch(float step_size) {
+        forward_batch<Stop>();
+        output_gradient.resize(outputs.shape());
+
+        float batch_err;
+        if (Stop != n_layers) {
+            batch_err = static_cast<loss::CrossEntropy*>(loss.get())->forward_backward_logits(outputs, y_batch, output_gradient);
+        } else {
+            batch_err = loss->forward(outputs, y_batch);
+            loss->backward(outputs, y_batch, output_gradient);
+        }
+
+        Buffers gradients;
+        for (std::size_t r = 0; r < batch_buffers.size(); r++) {
+            auto& gradient = std::get<Stop>(gradients);
+            std::copy_n(output_gradient.data() + r * widths[Stop], widths[Stop], gradient.data());
+            backward<Stop>(batch_buffers[r], gradients);
+        }
+        std::apply([&](auto&... layer) { (layer.step(step_size), ...); }, layers);
+        return batch_err;
+    }
+
+    template <std::size_t Stop>
+    std::tuple<float, float> evaluate(const Dataloader& dataloader) {
+        unsigned int correct_predictions = 0;
+        float loss_sum = 0.0f;
+        for (unsigned int batch = 0; batch < dataloader.n_batches; batch++) {
+            dataloader.load_batch(batch, x_batch, y_batch);
+            forward_batch<Stop>();
+            // softmax is monotonic, so the logits give the same predictions
+            loss_sum += Stop != n_layers
+                ? static_cast<loss::CrossEntropy*>(loss.get())->forward_logits(outputs, y_batch)
+                : loss->forward(outputs, y_batch);
+
+            for (std::size_t r = 0; r < outputs.shape()[0]; r++) {
+                const float* row = outputs.data() + r * widths[Stop];
+                std::size_t predicted = std::max_element(row, row + widths[Stop]) - row;
+                correct_predictions += predicted == static_cast<std::size_t>(y_batch(r, 0));
+            }
+        }
+        return {loss_sum / (float) dataloader.n_batches, (float) correct_predictions / (float) dataloader.total_samples};
+    }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __DATA_CONFIG_HPP__
+#define __DATA_CONFIG_HPP__
+
+#include "dataloader.hpp"
+#include <memory>
+
+struct DataSplits {
+    std::unique_ptr<Dataloader> train;
+    std::unique_ptr<Dataloader> val;
+    std::size_t n_classes;
+    // NHWC shape of the rows for image datasets, all zero otherwise
+    ImageShape image_shape{};
+};
+
+// Train and validation dataloaders described by config.json: "dataset"
+// (iris, mnist, svmlight or csv), the batch sizes, "validation_split" and the training "sampler".
+// csv reads "csv_path", "csv_delimiter", "csv_header", "csv_label_column",
+// "csv_feature_columns" and "csv_labels" (categorical or index), see CsvOptions.
+// A non-empty "dataset_cache" directory keeps the preprocessed samples there
+// and maps them on later runs, see dataset_cache.hpp (not for svmlight).
+DataSplits load_data_splits(const nlohmann::json& config);
+
+#endif
@@ -3,81 +3,143 @@
 
 #include "../common.hpp"
 #include "dataset.hpp"
+#include "sample_source.hpp"
+#include "sampler.hpp"
+#include <memory>
 #include <utility>
 
 class Dataloader {
-    xt::xarray<float> x_data;
-    xt::xarray<float> y_data;
+    std::shared_ptr<const SampleSource> source;
+    std::shared_ptr<const Sampler> sampler;
     
 public:
     unsigned int batch_size;
     unsigned int n_batches;
     unsigned int total_samples;
+    unsigned int n_features;
     
+    // Batches of the samples of `subset`, read through its shared source.
     Dataloader(Subset subset, unsigned int batch_size, bool shuffle = false)
-        : batch_size(batch_size),
-          x_data(std::move(subset.data)),
-          y_data(std::move(subset.labels)) 
+        : batch_size(batch_size)
     {
-        if (this->x_data.shape()[0] != this->y_data.shape()[0]) {
-            throw std::runtime_error("Input and output data must have the same number of samples.");
+        // a subset of every sample in order reads the source without the indirection
+        bool whole = subset.size() == subset.source->size();
+        for (std::size_t i = 0; whole && i < subset.size(); i++) {
+            whole = subset.indices[i] == i;
         }
-        
-        if (this->x_data.shape()[0] < batch_size) {
+        source = whole ? std::move(subset.source)
+                       : std::make_shared<IndexedSource>(std::move(subset.source), std::move(subset.indices));
+        // shuffling permutes indices each epoch, the samples stay in place
+        set_sampler(shuffle ? std::shared_ptr<const Sampler>(std::make_shared<RandomSampler>(source->size()))
+                            : std::make_shared<SequentialSampler>(source->size()));
+    }
+
+    // Batches read straight from `source`, e.g. a memory-mapped IdxSource.
+    // Without a sampler, samples are visited in storage order.
+    Dataloader(std::shared_ptr<const SampleSource> source, unsigned int batch_size,
+               std::shared_ptr<const Sampler> sampler = nullptr)
+        : source(std::move(source)), batch_size(batch_size)
+    {
+        set_sampler(sampler ? std::move(sampler) : std::make_shared<SequentialSampler>(this->source->size()));
+    }
+
+    // Another dataloader over the same samples and sampler, with its own
+    // batch size; the data is shared, not copied.
+    Dataloader rebatched(unsigned int new_batch_size) const {
+        return Dataloader(source, new_batch_size, sampler);
+    }
+
+    void set_sampler(std::shared_ptr<const Sampler> new_sampler) {
+        sampler = std::move(new_sampler);
+        if (sampler->size() < batch_size) {
             throw std::runtime_error("Batch size must be <= number of samples.");
         }
 
-        if (shuffle) {
-            auto& gen = xt::random::get_default_random_engine();
-            xt::random::shuffle(this->x_data, gen);
-            xt::random::shuffle(this->y_data, gen);
+        n_batches = sampler->size() / batch_size;
+        total_samples = source->size();
+        n_features = source->n_features();
+    }
+
+    // Class index of every sample, e.g. to build a StratifiedSampler.
+    std::vector<std::size_t> labels() const {
+        std::vector<std::size_t> result(source->size());
+        for (std::size_t i = 0; i < result.size(); i++) {
+            result[i] = source->label(i);
         }
+        return result;
+    }
+
+    // Order of the samples in `epoch`; batch b is indices [b * batch_size, (b + 1) * batch_size).
+    void epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const {
+        sampler->epoch_indices(epoch, indices);
+    }
 
-        n_batches = this->x_data.shape()[0] / batch_size;
-        total_samples = this->x_data.shape()[0];
+    // Gathers the samples listed in `indices` into caller-owned buffers;
+    // safe to call concurrently.
+    void gather(const std::size_t* indices, std::size_t count, Matrix& x_batch, Matrix& y_batch) const {
+        x_batch.resize({count, static_cast<std::size_t>(n_features)});
+        y_batch.resize({count, 1});
+        source->gather(indices, count, x_batch.data(), y_batch.data());
+    }
+
+    // Copies batch `batch_index`, in storage order, into caller-owned buffers;
+    // they are only reallocated if their shape differs from (batch_size, ...).
+    void load_batch(unsigned int batch_index, Matrix& x_batch, Matrix& y_batch) const {
+        load_rows(static_cast<std::size_t>(batch_index) * batch_size, batch_size, x_batch, y_batch);
+    }
+
+    // Copies `count` samples starting at `first`; safe to call concurrently.
+    void load_rows(std::size_t first, std::size_t count, Matrix& x_batch, Matrix& y_batch) const {
+        x_batch.resize({count, static_cast<std::size_t>(n_features)});
+        y_batch.resize({count, 1});
+        source->load_rows(first, count, x_batch.data(), y_batch.data());
+    }
+
+    // Whether the source hands out CSR batches, see gather_sparse.
+    bool sparse() const { return source->sparse(); }
+
+    // gather and load_rows for sparse sources, in CSR form.
+    void gather_sparse(const std::size_t* indices, std::size_t count, CsrMatrix& x_batch, Matrix& y_batch) const {
+        y_batch.resize({count, 1});
+        source->gather_sparse(indices, count, x_batch, y_batch.data());
+    }
+
+    void load_rows_sparse(std::size_t first, std::size_t count, CsrMatrix& x_batch, Matrix& y_batch) const {
+        y_batch.resize({count, 1});
+        source->load_rows_sparse(first, count, x_batch, y_batch.data());
     }
 
     class iterator {
-        const xt::xarray<float>& x_data;
-        const xt::xarray<float>& y_data;
-        unsigned int batch_size;
-        unsigned int current_index;
+        const Dataloader& dataloader;
+        unsigned int current_batch;
 
     public:
-        iterator(const xt::xarray<float>& x_data,
-                 const xt::xarray<float>& y_data,
-                 unsigned int batch_size,
-                 unsigned int current_index = 0)
-            : x_data(x_data), y_data(y_data), batch_size(batch_size), current_index(current_index) {}
+        iterator(const Dataloader& dataloader, unsigned int current_batch = 0)
+            : dataloader(dataloader), current_batch(current_batch) {}
 
         bool operator!=(const iterator& other) const {
-            return current_index != other.current_index;
+            return current_batch != other.current_batch;
         }
 
         iterator& operator++() {
-            current_index += batch_size;
+            current_batch++;
             return *this;
         }
 
-        std::pair<xt::xarray<float>, xt::xarray<float>> operator*() const {
-            auto start = current_index;
-            auto end = std::min(current_index + batch_size, (unsigned int)x_data.shape(0));
-
-            auto x_batch = xt::view(x_data, xt::range(start, end), xt::all());
-            auto y_batch = xt::view(y_data, xt::range(start, end), xt::all());
-
-            return {x_batch, y_batch};
+        std::pair<Matrix, Matrix> operator*() const {
+            std::pair<Matrix, Matrix> batch;
+            dataloader.load_batch(current_batch, batch.first, batch.second);
+            return batch;
         }
     };
 
     iterator begin() {
-        return iterator(x_data, y_data, batch_size, 0);
+        return iterator(*this, 0);
     }
 
     iterator end() {
-        unsigned int last_batch_start = (x_data.shape(0) / batch_size) * batch_size;
-        return iterator(x_data, y_data, batch_size, last_batch_start);
+        return iterator(*this, n_batches);
     }
 };
 
-#endif
+#endif
\ No newline at end of file
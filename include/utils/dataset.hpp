@@ -2,25 +2,54 @@
 #define __DATASET_HPP__
 
 #include "../common.hpp"
+#include "../sparse.hpp"
+#include "sample_source.hpp"
+#include "sampler.hpp"
+#include <memory>
 
+// Some samples of a dataset: indices into a source shared by every subset
+// of it, so splits and folds copy indices, never the samples.
 struct Subset {
-    xt::xarray<float> data;
-    xt::xarray<uint> labels;
+    std::shared_ptr<const SampleSource> source;
+    std::vector<std::size_t> indices;
+
+    std::size_t size() const { return indices.size(); }
+
+    // Every sample of `data` (samples, features), in order.
+    static Subset of(Matrix data, const xt::xarray<uint>& labels);
 };
 struct DatasetSplit {
     Subset train;
     Subset val;
     Subset test;
 };
+struct Fold {
+    Subset train;
+    Subset val;
+};
 
+// Features are either dense in `data` or, for mostly-zero features, CSR in
+// `sparse_data`, with `data` left empty. The first split moves them and
+// `labels` into a shared source, leaving them empty: the samples are held
+// once whatever the number of splits, folds and dataloaders.
 class Dataset {
+    std::shared_ptr<const SampleSource> samples;
+
 public:
-    xt::xarray<float> data;
+    Matrix data;
     xt::xarray<uint> labels;
+    CsrMatrix sparse_data;  // instead of data, for sparse datasets
     
     virtual ~Dataset() = default;
+
+    // The source every subset of this dataset reads from.
+    std::shared_ptr<const SampleSource> source();
+
+    // Splits a random permutation of the samples, so the file order (often
+    // sorted by class) does not leak into the splits.
     DatasetSplit split_dataset(float val_ratio = 0.2f, float test_ratio = 0.1f) {
-        std::size_t total_samples = data.shape()[0];
+        auto shared = source();
+        std::size_t total_samples = shared->size();
         std::size_t val_size = static_cast<std::size_t>(total_samples * val_ratio);
         std::size_t test_size = static_cast<std::size_t>(total_samples * test_ratio);
         std::size_t train_size = total_samples - val_size - test_size;
@@ -30,24 +59,23 @@ public:
                   << ", Test: " << test_size 
                   << std::endl;
                   
-        Subset train_subset;
-        train_subset.data = xt::view(data, xt::range(0, train_size), xt::all());
-        train_subset.labels = xt::view(labels, xt::range(0, train_size), xt::all());
-
-        Subset val_subset;
-        val_subset.data = xt::view(data, xt::range(train_size, train_size + val_size), xt::all());
-        val_subset.labels = xt::view(labels, xt::range(train_size, train_size + val_size), xt::all());
-
-        Subset test_subset;
-        test_subset.data = xt::view(data, xt::range(train_size + val_size, total_samples), xt::all());
-        test_subset.labels = xt::view(labels, xt::range(train_size + val_size, total_samples), xt::all());
+        std::vector<std::size_t> order;
+        RandomSampler(total_samples).epoch_indices(0, order);
+        auto take = [&](std::size_t first, std::size_t count) {
+            return Subset{shared, std::vector<std::size_t>(order.begin() + first, order.begin() + first + count)};
+        };
 
         return DatasetSplit{
-            .train = train_subset,
-            .val = val_subset,
-            .test = test_subset
+            .train = take(0, train_size),
+            .val = take(train_size, val_size),
+            .test = take(train_size + val_size, total_samples - train_size - val_size)
         };
     }
+
+    // k-fold cross-validation: one random permutation cut into k parts,
+    // fold i validating on part i and training on the others. A seed of 0
+    // draws one, as RandomSampler does.
+    std::vector<Fold> k_folds(std::size_t k, uint64_t seed = 0);
 };
 
 class MNISTDataset: public Dataset {
@@ -61,9 +89,49 @@ public:
 
 };
 
-class IrisDataset: public Dataset {
+// Delimited text with one sample per line, e.g. CSV. Label column and
+// feature columns are picked by index; a negative index counts from the
+// end, so the default label is the last column.
+struct CsvOptions {
+    enum class Labels {
+        Categorical,    // any text, classes numbered in order of first appearance
+        Index           // already a class index 0, 1, ...
+    };
+
+    char delimiter = ',';
+    bool header = false;                  // skip the first line
+    int label_column = -1;
+    std::vector<int> feature_columns;     // empty: every column but the label
+    Labels labels = Labels::Categorical;
+    std::size_t threads = 0;              // 0: one per hardware thread
+};
+
+// Maps the file and parses it in parallel: the bytes are cut into chunks
+// that end on a newline, each thread counts the rows of its chunk, then
+// parses them with std::from_chars straight into `data`, allocated once
+// for the whole file. Throws on a malformed line.
+class CsvDataset: public Dataset {
+public:
+    std::size_t n_classes = 0;
+    std::vector<std::string> class_names;   // Categorical labels only
+
+    CsvDataset(const std::string& file_path, const CsvOptions& options = CsvOptions());
+};
+
+// The UCI Iris file: 4 features and the species name.
+class IrisDataset: public CsvDataset {
+public:
+    IrisDataset(const std::string& file_path) : CsvDataset(file_path) {}
+};
+
+// SVMlight / libsvm text, one "label index:value ..." line per sample with
+// 1-based ascending indices, loaded as sparse_data. Labels are numbered in
+// ascending order.
+class SvmLightDataset: public Dataset {
 public:
-    IrisDataset(const std::string& file_path);
+    std::size_t n_classes = 0;
+
+    SvmLightDataset(const std::string& file_path);
 };
 
 std::tuple<xt::xarray<float>, xt::xarray<unsigned char>> load_idx_data(const std::string& image_path, const std::string& label_path);
@@ -0,0 +1,85 @@
+#ifndef __DATASET_CACHE_HPP__
+#define __DATASET_CACHE_HPP__
+
+#include "mapped_file.hpp"
+#include "sample_source.hpp"
+#include <cstdint>
+#include <memory>
+
+// Preprocessed dataset, written once and mapped on later runs, in host byte order:
+//   Header                  64 bytes
+//   features                (rows, features) floats, 64-byte aligned
+//   labels                  rows floats (class indices), 64-byte aligned
+// The rows are already normalized and shuffled, so a contiguous slice is a
+// random split and a batch is a plain copy out of the page cache.
+namespace dataset_cache {
+    constexpr char magic[8] = {'N', 'N', 'D', 'S', 'E', 'T', 0, 0};
+    constexpr uint32_t version = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t classes;
+        uint64_t key;
+        uint64_t rows;
+        uint64_t features;
+        uint32_t height;        // image datasets only, all zero otherwise
+        uint32_t width;
+        uint32_t channels;
+        uint8_t reserved[12];
+    };
+    static_assert(sizeof(Header) == 64);
+
+    // Hash of the source files (path, size and modification time) and of the
+    // preprocessing parameters: any change gives a new key, so a stale cache
+    // is never read.
+    uint64_t key(const std::vector<std::string>& source_paths, const std::string& parameters);
+
+    // <directory>/<key in hex>.cache
+    std::string path(const std::string& directory, uint64_t key);
+
+    // Writes every sample of `source` in the order of `order` to `path`,
+    // through a temporary file renamed at the end, so concurrent runs never
+    // see a partial cache.
+    void write(const std::string& path, uint64_t key, const SampleSource& source, std::size_t classes,
+               const ImageShape& shape, const std::vector<std::size_t>& order);
+}
+
+// Samples of a dataset cache file, read in place from the mapping.
+class CachedSource: public SampleSource {
+    std::shared_ptr<const MappedFile> file;
+    const float* rows = nullptr;
+    const float* labels = nullptr;
+    std::size_t count = 0;
+    std::size_t row_size = 0;
+    std::size_t classes = 0;
+    ImageShape shape{};
+
+    CachedSource() = default;
+
+public:
+    // The cache at `path`, or null if it is missing or was not written for `key`.
+    static std::shared_ptr<CachedSource> open(const std::string& path, uint64_t key);
+
+    std::size_t size() const override { return count; }
+    std::size_t n_features() const override { return row_size; }
+    std::size_t n_classes() const { return classes; }
+    ImageShape image_shape() const { return shape; }
+
+    void load_rows(std::size_t first, std::size_t n, float* x, float* y) const override {
+        std::copy_n(rows + first * row_size, n * row_size, x);
+        std::copy_n(labels + first, n, y);
+    }
+
+    void gather(const std::size_t* indices, std::size_t n, float* x, float* y) const override {
+        kernels::gather_rows(rows, row_size, indices, n, x);
+        kernels::gather_rows(labels, 1, indices, n, y);
+    }
+
+    std::size_t label(std::size_t i) const override { return static_cast<std::size_t>(labels[i]); }
+
+    // Samples [first, first + n) of this source, sharing its mapping.
+    std::shared_ptr<CachedSource> slice(std::size_t first, std::size_t n) const;
+};
+
+#endif
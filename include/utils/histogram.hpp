@@ -0,0 +1,67 @@
+#ifndef __HISTOGRAM_HPP__
+#define __HISTOGRAM_HPP__
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of durations: 8 buckets per power of two of
+// nanoseconds, so a percentile is within about 6% of the exact value.
+// Recording is O(1) and never allocates.
+class LatencyHistogram {
+    static constexpr int sub_buckets = 8;
+    std::array<std::size_t, 64 * sub_buckets> counts{};
+    std::size_t total = 0;
+
+    static std::size_t bucket(uint64_t ns) {
+        if (ns < sub_buckets) {
+            return ns;
+        }
+        int exponent = 63 - __builtin_clzll(ns);
+        uint64_t mantissa = (ns >> (exponent - 3)) & (sub_buckets - 1);
+        return (exponent - 2) * sub_buckets + mantissa;
+    }
+
+    // midpoint of a bucket, in nanoseconds
+    static double value(std::size_t index) {
+        if (index < sub_buckets) {
+            return static_cast<double>(index);
+        }
+        int exponent = static_cast<int>(index / sub_buckets) + 2;
+        double low = static_cast<double>((sub_buckets + index % sub_buckets) << (exponent - 3));
+        return low + static_cast<double>(uint64_t(1) << (exponent - 3)) / 2.0;
+    }
+
+public:
+    void record(std::chrono::nanoseconds duration) {
+        counts[bucket(static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)))]++;
+        total++;
+    }
+
+    std::size_t count() const { return total; }
+
+    // p in [0, 1], in microseconds
+    double percentile(double p) const {
+        if (total == 0) {
+            return 0.0;
+        }
+        std::size_t rank = static_cast<std::size_t>(p * (total - 1)) + 1;
+        std::size_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return value(i) / 1000.0;
+            }
+        }
+        return value(counts.size() - 1) / 1000.0;
+    }
+
+    void reset() {
+        counts.fill(0);
+        total = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef __IDX_DATASET_HPP__
+#define __IDX_DATASET_HPP__
+
+#include "mapped_file.hpp"
+#include "sample_source.hpp"
+#include <array>
+#include <memory>
+
+// Dimensions of an IDX file of unsigned bytes, read from the mapped header.
+// Throws if the magic number, the element type or the payload size is wrong.
+std::vector<uint32_t> get_idx_dimension(const MappedFile& file);
+inline std::size_t idx_data_offset(std::size_t n_dim) { return 4 + 4 * n_dim; }
+
+// Scales n pixels from [0, 255] to [0, 1].
+void idx_to_float(const unsigned char* pixels, float* out, std::size_t n);
+
+// Images and labels of an IDX pair (MNIST layout), memory-mapped. The uint8
+// pixels stay in the page cache and only the rows of a batch are converted to
+// float, so datasets far larger than RAM at float32 train without loading.
+class IdxSource: public SampleSource {
+    std::shared_ptr<const MappedFile> image_file;
+    std::shared_ptr<const MappedFile> label_file;
+    const unsigned char* pixels = nullptr;
+    const unsigned char* labels = nullptr;
+    std::size_t count = 0;
+    std::size_t row_size = 0;
+    ImageShape shape{};
+    // raw label byte -> class index, sorted like remap_labels
+    std::array<float, 256> label_map{};
+    std::size_t classes = 0;
+
+public:
+    IdxSource(const std::string& images_path, const std::string& labels_path);
+
+    std::size_t size() const override { return count; }
+    std::size_t n_features() const override { return row_size; }
+    std::size_t n_classes() const { return classes; }
+    // Rows are the images as stored, row-major with one channel: NHWC as is.
+    ImageShape image_shape() const { return shape; }
+
+    void load_rows(std::size_t first, std::size_t count, float* x, float* y) const override;
+    void gather(const std::size_t* indices, std::size_t count, float* x, float* y) const override;
+    std::size_t label(std::size_t i) const override { return static_cast<std::size_t>(label_map[labels[i]]); }
+
+    // Samples [first, first + count) of this source, sharing its mappings.
+    std::shared_ptr<IdxSource> slice(std::size_t first, std::size_t count) const;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <string>
+
+// Read-only mapping of a whole file. Pages are read by the kernel on first
+// touch and stay in the page cache, so opening is instant whatever the size.
+// A copy-on-write mapping can also be written to: modified pages become
+// private copies and the file itself never changes.
+class MappedFile {
+    unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+    bool writable = false;
+
+public:
+    explicit MappedFile(const std::string& path, bool copy_on_write = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return bytes; }
+    // Only for copy-on-write mappings.
+    unsigned char* mutable_data();
+    std::size_t size() const { return length; }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef __PREFETCHER_HPP__
+#define __PREFETCHER_HPP__
+
+#include "dataloader.hpp"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// Produces the batches of a Dataloader ahead of the training loop. A
+// background thread fills a ring of `depth` preallocated slots, epoch after
+// epoch in the sampler's order, while the consumer trains on the oldest one. Each slot is split into
+// the row shards the consumer asked for, so data-parallel workers read their
+// shard in place instead of copying it. Slot memory is mlock'ed when the
+// RLIMIT_MEMLOCK allows it, so a batch never page-faults on the hot path.
+class Prefetcher {
+public:
+    struct Shard {
+        Matrix x;
+        Matrix y;
+        CsrMatrix x_sparse;     // in place of x when the dataloader is sparse
+    };
+
+    struct Slot {
+        std::vector<Shard> shards;
+        unsigned int epoch = 0;
+        unsigned int batch = 0;
+    };
+
+    struct Stats {
+        std::size_t batches = 0;
+        // time the producer waited on a full ring: data is ahead of training
+        double backpressure_s = 0.0;
+        // time the consumer waited on an empty ring: data is on the critical path
+        double stall_s = 0.0;
+        std::size_t stalls = 0;
+    };
+
+    Prefetcher(const Dataloader& dataloader, const std::vector<std::size_t>& shard_sizes, std::size_t depth,
+               unsigned int first_epoch = 0);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // Blocks until the next batch is ready. It stays valid until release().
+    // Rethrows an exception of the producer once the batches before it are consumed.
+    const Slot& acquire();
+    void release();
+
+    // Statistics since the last call; counters restart from zero.
+    Stats take_stats();
+    bool pinned() const { return pinned_memory; }
+
+private:
+    const Dataloader& dataloader;
+    std::vector<Slot> slots;
+    std::size_t head = 0;       // next slot to consume
+    std::size_t filled = 0;
+    unsigned int first_epoch;
+    bool stopping = false;
+    bool pinned_memory = false;
+    std::exception_ptr error;   // thrown by the producer, which then stops
+    Stats stats;
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::condition_variable free_cv;
+    std::thread producer;
+
+    void produce();
+    void run_producer();
+    void fill(Slot& slot, const std::vector<std::size_t>& order, unsigned int epoch, unsigned int batch);
+};
+
+#endif
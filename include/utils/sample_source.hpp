@@ -0,0 +1,171 @@
+#ifndef __SAMPLE_SOURCE_HPP__
+#define __SAMPLE_SOURCE_HPP__
+
+#include "../common.hpp"
+#include "../sparse.hpp"
+#include "../kernels/gather.hpp"
+#include <memory>
+#include <vector>
+
+// Where a Dataloader reads its samples from. A source hands out rows as
+// float features and a float class index, converting them only when a batch
+// asks for them. load_rows must be safe to call from several threads.
+class SampleSource {
+public:
+    virtual ~SampleSource() = default;
+
+    virtual std::size_t size() const = 0;
+    virtual std::size_t n_features() const = 0;
+    // Writes samples [first, first + count) into x (count, n_features) and y (count, 1).
+    virtual void load_rows(std::size_t first, std::size_t count, float* x, float* y) const = 0;
+    // Same for the samples listed in `indices`, in that order.
+    virtual void gather(const std::size_t* indices, std::size_t count, float* x, float* y) const = 0;
+    // Class index of sample i.
+    virtual std::size_t label(std::size_t i) const = 0;
+
+    // Sources of mostly-zero features also hand out their rows in CSR form,
+    // replacing the content of x.
+    virtual bool sparse() const { return false; }
+    virtual void load_rows_sparse(std::size_t first, std::size_t count, CsrMatrix& x, float* y) const {
+        throw std::runtime_error("SampleSource: rows are only available dense.");
+    }
+    virtual void gather_sparse(const std::size_t* indices, std::size_t count, CsrMatrix& x, float* y) const {
+        throw std::runtime_error("SampleSource: rows are only available dense.");
+    }
+};
+
+// Samples already held as float matrices.
+class MemorySource: public SampleSource {
+    Matrix x_data;
+    Matrix y_data;
+
+public:
+    MemorySource(Matrix x_data, Matrix y_data)
+        : x_data(std::move(x_data)), y_data(std::move(y_data)) {}
+
+    std::size_t size() const override { return x_data.shape()[0]; }
+    std::size_t n_features() const override { return x_data.shape()[1]; }
+
+    void load_rows(std::size_t first, std::size_t count, float* x, float* y) const override {
+        std::copy_n(x_data.data() + first * x_data.shape()[1], count * x_data.shape()[1], x);
+        std::copy_n(y_data.data() + first, count, y);
+    }
+
+    void gather(const std::size_t* indices, std::size_t count, float* x, float* y) const override {
+        kernels::gather_rows(x_data.data(), x_data.shape()[1], indices, count, x);
+        kernels::gather_rows(y_data.data(), 1, indices, count, y);
+    }
+
+    std::size_t label(std::size_t i) const override { return static_cast<std::size_t>(y_data(i, 0)); }
+};
+
+// Samples held as a CsrMatrix: memory scales with the non-zeros. Dense
+// rows are still served, scattered into zeros, for the paths without
+// sparse support.
+class SparseSource: public SampleSource {
+    CsrMatrix x_data;
+    Matrix y_data;
+
+public:
+    SparseSource(CsrMatrix x_data, Matrix y_data)
+        : x_data(std::move(x_data)), y_data(std::move(y_data)) {}
+
+    std::size_t size() const override { return x_data.rows; }
+    std::size_t n_features() const override { return x_data.cols; }
+    bool sparse() const override { return true; }
+
+    void load_rows(std::size_t first, std::size_t count, float* x, float* y) const override {
+        std::fill_n(x, count * x_data.cols, 0.0f);
+        for (std::size_t i = 0; i < count; i++) {
+            scatter_row(first + i, x + i * x_data.cols);
+        }
+        std::copy_n(y_data.data() + first, count, y);
+    }
+
+    void gather(const std::size_t* indices, std::size_t count, float* x, float* y) const override {
+        std::fill_n(x, count * x_data.cols, 0.0f);
+        for (std::size_t i = 0; i < count; i++) {
+            scatter_row(indices[i], x + i * x_data.cols);
+        }
+        kernels::gather_rows(y_data.data(), 1, indices, count, y);
+    }
+
+    void load_rows_sparse(std::size_t first, std::size_t count, CsrMatrix& x, float* y) const override {
+        x.clear(x_data.cols);
+        for (std::size_t i = 0; i < count; i++) {
+            x.append_row(x_data, first + i);
+        }
+        std::copy_n(y_data.data() + first, count, y);
+    }
+
+    void gather_sparse(const std::size_t* indices, std::size_t count, CsrMatrix& x, float* y) const override {
+        x.clear(x_data.cols);
+        for (std::size_t i = 0; i < count; i++) {
+            x.append_row(x_data, indices[i]);
+        }
+        kernels::gather_rows(y_data.data(), 1, indices, count, y);
+    }
+
+    std::size_t label(std::size_t i) const override { return static_cast<std::size_t>(y_data(i, 0)); }
+
+private:
+    void scatter_row(std::size_t i, float* row) const {
+        for (std::size_t k = x_data.row_offsets[i]; k < x_data.row_offsets[i + 1]; k++) {
+            row[x_data.columns[k]] = x_data.values[k];
+        }
+    }
+};
+
+// Samples `indices` of a shared source, in that order: a view, the
+// samples stay in `base`.
+class IndexedSource: public SampleSource {
+    std::shared_ptr<const SampleSource> base;
+    std::vector<std::size_t> indices;
+
+    // indices of the batch in `base`, per thread so concurrent loads never share them
+    const std::size_t* mapped(const std::size_t* batch, std::size_t count) const {
+        thread_local std::vector<std::size_t> base_indices;
+        base_indices.resize(count);
+        for (std::size_t i = 0; i < count; i++) {
+            base_indices[i] = indices[batch[i]];
+        }
+        return base_indices.data();
+    }
+
+public:
+    IndexedSource(std::shared_ptr<const SampleSource> base, std::vector<std::size_t> indices)
+        : base(std::move(base)), indices(std::move(indices))
+    {
+        // a view of a view reads the underlying source directly
+        if (auto view = std::dynamic_pointer_cast<const IndexedSource>(this->base)) {
+            for (auto& index : this->indices) {
+                index = view->indices[index];
+            }
+            this->base = view->base;
+        }
+    }
+
+    std::size_t size() const override { return indices.size(); }
+    std::size_t n_features() const override { return base->n_features(); }
+    bool sparse() const override { return base->sparse(); }
+
+    void load_rows(std::size_t first, std::size_t count, float* x, float* y) const override {
+        base->gather(indices.data() + first, count, x, y);
+    }
+
+    void gather(const std::size_t* batch, std::size_t count, float* x, float* y) const override {
+        base->gather(mapped(batch, count), count, x, y);
+    }
+
+    void load_rows_sparse(std::size_t first, std::size_t count, CsrMatrix& x, float* y) const override {
+        base->gather_sparse(indices.data() + first, count, x, y);
+    }
+
+    void gather_sparse(const std::size_t* batch, std::size_t count, CsrMatrix& x, float* y) const override {
+        base->gather_sparse(mapped(batch, count), count, x, y);
+    }
+
+    std::size_t label(std::size_t i) const override { return base->label(indices[i]); }
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __SAMPLER_HPP__
+#define __SAMPLER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Decides which samples a Dataloader visits in an epoch, and in which order,
+// as a list of indices. Batches are then gathered from the list, so the data
+// itself never moves. The order depends only on the seed and the epoch, so
+// every thread that asks for an epoch gets the same list.
+class Sampler {
+public:
+    virtual ~Sampler() = default;
+
+    // Number of indices per epoch.
+    virtual std::size_t size() const = 0;
+    virtual void epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const = 0;
+};
+
+// 0, 1, ..., n - 1 every epoch.
+class SequentialSampler: public Sampler {
+    std::size_t n;
+
+public:
+    explicit SequentialSampler(std::size_t n) : n(n) {}
+
+    std::size_t size() const override { return n; }
+    void epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const override;
+};
+
+// A new random permutation every epoch, O(n) indices to reshuffle.
+class RandomSampler: public Sampler {
+    std::size_t n;
+    uint64_t seed;
+
+public:
+    // A seed of 0 draws one from xt::random's default engine.
+    explicit RandomSampler(std::size_t n, uint64_t seed = 0);
+
+    std::size_t size() const override { return n; }
+    void epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const override;
+};
+
+// Random order in which every window of consecutive indices, and so every
+// batch, holds the classes in about the same proportions as the dataset.
+class StratifiedSampler: public Sampler {
+    std::vector<std::vector<std::size_t>> classes;
+    std::size_t n = 0;
+    uint64_t seed;
+
+public:
+    StratifiedSampler(const std::vector<std::size_t>& labels, uint64_t seed = 0);
+
+    std::size_t size() const override { return n; }
+    void epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const override;
+};
+
+// Draws `n_samples` indices with replacement, index i with probability
+// proportional to weights[i].
+class WeightedSampler: public Sampler {
+    std::vector<double> weights;
+    std::size_t n_samples;
+    uint64_t seed;
+
+public:
+    WeightedSampler(std::vector<double> weights, std::size_t n_samples, uint64_t seed = 0);
+
+    // Weights that make every class equally likely.
+    static std::vector<double> class_balanced(const std::vector<std::size_t>& labels);
+
+    std::size_t size() const override { return n_samples; }
+    void epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const override;
+};
+
+// Builds the sampler named by config["sampler"]: sequential, random,
+// stratified or weighted (class-balanced, one epoch = labels.size() draws).
+std::shared_ptr<Sampler> make_sampler(const nlohmann::json& config, const std::vector<std::size_t>& labels);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of threads that all run the same task with their own index.
+// run() blocks until every worker is done; the calling thread acts as
+// worker 0, so a pool of size 1 starts no thread at all. Tasks are passed
+// by reference, without std::function, so dispatching never allocates.
+class WorkerPool {
+    using Trampoline = void (*)(void*, std::size_t);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    Trampoline trampoline = nullptr;
+    void* task = nullptr;
+    std::size_t generation = 0;
+    std::size_t pending = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void worker_loop(std::size_t index);
+    void dispatch(Trampoline trampoline, void* task);
+
+public:
+    explicit WorkerPool(std::size_t n_workers);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    std::size_t size() const { return threads.size() + 1; }
+
+    template <class F>
+    void run(F&& f) {
+        using Task = std::remove_reference_t<F>;
+        dispatch([](void* task, std::size_t index) { (*static_cast<Task*>(task))(index); },
+                 const_cast<void*>(static_cast<const void*>(&f)));
+    }
+};
+
+#endif
\ No newline at end of file
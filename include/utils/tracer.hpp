@@ -0,0 +1,102 @@
+#ifndef __TRACER_HPP__
+#define __TRACER_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Compiled in unless built with -DNN_TRACING=0; it must then be switched on
+// at runtime too (Model::setTracing). Compiled out, every probe is dead code.
+#ifndef NN_TRACING
+#define NN_TRACING 1
+#endif
+constexpr bool tracing_compiled = NN_TRACING;
+
+// Totals of one operation over an epoch.
+struct TraceRow {
+    std::string name;
+    std::string phase;
+    std::size_t calls = 0;
+    double total_ms = 0.0;
+    double gflops = 0.0;        // achieved GFLOP/s, 0 for operations without FLOPs
+    double gbytes_per_s = 0.0;
+};
+
+struct TraceSummary {
+    std::vector<TraceRow> rows;
+
+    bool empty() const { return rows.empty(); }
+    void print(std::ostream& out) const;
+};
+
+// Hot-path timings of the training loop. Each data-parallel worker records
+// into its own Lane, so probes take no lock: a probe is two clock reads and
+// an append. Layer operations are keyed by layer index; every event also
+// feeds per-operation totals that are handed out once per epoch.
+class Tracer {
+public:
+    enum class Phase : uint8_t { Forward, Backward, Loss, Data, Reduce, Optimizer };
+
+    struct Event {
+        int64_t start_ns;
+        int64_t duration_ns;
+        double flops;
+        double bytes;
+        uint32_t layer;
+        Phase phase;
+    };
+
+    class Lane {
+        friend class Tracer;
+
+        struct Totals {
+            std::size_t calls = 0;
+            int64_t ns = 0;
+            double flops = 0.0;
+            double bytes = 0.0;
+        };
+
+        std::vector<Event> events;
+        std::vector<Totals> totals;
+        std::size_t max_events = 0;
+        std::size_t dropped = 0;
+        std::size_t n_layers = 0;
+
+    public:
+        // `layer` is ignored for the phases that are not per layer.
+        void record(uint32_t layer, Phase phase, int64_t start_ns, int64_t end_ns, double flops = 0.0, double bytes = 0.0);
+    };
+
+    bool enabled = false;
+    // events kept for the Chrome trace; totals keep counting past it
+    std::size_t max_events = std::size_t(1) << 20;
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Starts a trace of a model with these layers, run by `n_lanes` workers.
+    void configure(std::vector<std::string> layer_names, std::vector<std::size_t> layer_parameters, std::size_t n_lanes);
+
+    Lane& lane(std::size_t index) { return lanes[index]; }
+    std::size_t parameter_count(std::size_t layer) const { return layer_parameters[layer]; }
+
+    // Totals since the last call, summed over the lanes; counters restart from zero.
+    TraceSummary take_summary();
+
+    // Chrome trace_event JSON, for chrome://tracing or Perfetto.
+    void write_chrome_trace(const std::string& path) const;
+
+private:
+    std::vector<std::string> layer_names;
+    std::vector<std::size_t> layer_parameters;
+    std::vector<Lane> lanes;
+    int64_t origin_ns = 0;
+
+    std::string event_name(uint32_t layer, Phase phase) const;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __WORKSPACE_HPP__
+#define __WORKSPACE_HPP__
+
+#include "common.hpp"
+#include "sparse.hpp"
+#include <array>
+#include <map>
+
+// What Model::reserve lays a workspace out for.
+enum class WorkspaceKind { Training, MixedPrecision, Inference, Recompute };
+
+// Activation and gradient buffers for one batch size, sized once by
+// Model::reserve. activations[i] is the input of layer i and activations[i + 1]
+// its output; gradients[i] is the loss gradient w.r.t. activations[i].
+// activation_buffers and gradient_buffers point at them whatever the layout.
+//
+// In mixed precision, the input of layer i is kept for backward in bf16 only
+// (stored[i], rows padded to kernels::bf16_padded), and the fp32 buffers
+// behind activation_buffers and gradient_buffers are shared by the layers of
+// the same width: two for activations and two for gradients, alternating
+// with the layer index so a layer's input and output never land in the same
+// one. activations then only holds the fp32 input batch and gradients is empty.
+//
+// For inference (no gradients), activations only holds the input batch too;
+// every other activation is one of two ping-pong buffers per width, and a
+// layer that can run in place writes over its input.
+//
+// With recompute, only the input of every segment-th layer is kept
+// (activations[i / segment]); the activations inside a segment live in
+// segment_buffers, keyed by position in the segment and width, and are
+// recomputed from the segment's input before its backward. Gradients take
+// the two gradient buffers per width of the mixed-precision layout.
+struct Workspace {
+    std::vector<Matrix> activations;
+    std::vector<Matrix> gradients;
+    Matrix truths;
+    // the batch of a sparse dataloader, in place of activations[0]
+    CsrMatrix sparse_inputs;
+
+    std::vector<Bf16Matrix> stored;
+    std::vector<Matrix*> activation_buffers;
+    std::vector<Matrix*> gradient_buffers;
+    std::map<std::size_t, std::array<Matrix, 4>> shared_buffers;
+    std::map<std::pair<std::size_t, std::size_t>, Matrix> segment_buffers;
+    // layers per recompute segment, 1 when every activation is kept
+    std::size_t segment = 1;
+
+    // Bytes held by the activation and gradient buffers.
+    std::size_t bytes() const {
+        std::size_t total = 0;
+        for (const auto& buffer : activations) {
+            total += buffer.size() * sizeof(float);
+        }
+        for (const auto& buffer : gradients) {
+            total += buffer.size() * sizeof(float);
+        }
+        total += sparse_inputs.nnz() * (sizeof(float) + sizeof(uint32_t));
+        for (const auto& buffer : stored) {
+            total += buffer.size() * sizeof(uint16_t);
+        }
+        for (const auto& [width, buffers] : shared_buffers) {
+            for (const auto& buffer : buffers) {
+                total += buffer.size() * sizeof(float);
+            }
+        }
+        for (const auto& [key, buffer] : segment_buffers) {
+            total += buffer.size() * sizeof(float);
+        }
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "checkpoint.hpp"
+#include "conv_layer.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+namespace checkpoint {
+
+    namespace {
+        std::size_t align(std::size_t offset) {
+            return (offset + arena_alignment - 1) / arena_alignment * arena_alignment;
+        }
+
+        void describe_image(const ImageShape& shape, LayerRecord& record) {
+            record.height = static_cast<uint32_t>(shape.height);
+            record.width = static_cast<uint32_t>(shape.width);
+            record.channels = static_cast<uint32_t>(shape.channels);
+        }
+
+        std::unique_ptr<Layer> make_activation(kernels::Activation kind, float alpha) {
+            switch (kind) {
+                case kernels::Activation::Sigmoid:
+                    return std::make_unique<activation::Sigmoid>();
+                case kernels::Activation::Tanh:
+                    return std::make_unique<activation::Tanh>();
+                case kernels::Activation::ReLU:
+                    return std::make_unique<activation::ReLU>();
+                case kernels::Activation::LeakyReLU:
+                    return std::make_unique<activation::LeakyReLU>();
+                case kernels::Activation::ELU:
+                    return std::make_unique<activation::ELU>(alpha);
+                case kernels::Activation::GELU:
+                    return std::make_unique<activation::GELU>();
+                default:
+                    return std::make_unique<activation::BaseActivation>(kind, alpha);
+            }
+        }
+    }
+
+    std::size_t parameters_offset(std::size_t layer_count) {
+        return align(sizeof(Header) + layer_count * sizeof(LayerRecord));
+    }
+
+    LayerRecord describe(const Layer& layer) {
+        LayerRecord record{};
+        if (auto fused = dynamic_cast<const DenseActivation*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::DenseActivation);
+            record.activation = static_cast<uint32_t>(fused->activation());
+            record.alpha = fused->parameter();
+            record.input_size = fused->weights.cols;
+            record.output_size = fused->weights.rows;
+        } else if (auto dense = dynamic_cast<const DenseLayer*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::Dense);
+            record.input_size = dense->weights.cols;
+            record.output_size = dense->weights.rows;
+        } else if (auto conv = dynamic_cast<const Conv2DLayer*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::Conv2D);
+            describe_image(conv->input_image(), record);
+            record.filters = static_cast<uint32_t>(conv->weights.rows);
+            record.window = static_cast<uint32_t>(conv->kernel());
+            record.stride = static_cast<uint32_t>(conv->step());
+            record.padding = static_cast<uint32_t>(conv->pad());
+        } else if (auto pool = dynamic_cast<const MaxPool2D*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::MaxPool2D);
+            describe_image(pool->input_image(), record);
+            record.window = static_cast<uint32_t>(pool->window());
+            record.stride = static_cast<uint32_t>(pool->step());
+        } else if (auto flatten = dynamic_cast<const Flatten*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::Flatten);
+            describe_image(flatten->input_image(), record);
+        } else if (dynamic_cast<const activation::Softmax*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::Softmax);
+        } else if (auto activation_layer = dynamic_cast<const activation::BaseActivation*>(&layer)) {
+            record.type = static_cast<uint32_t>(LayerType::Activation);
+            record.activation = static_cast<uint32_t>(activation_layer->kind());
+            record.alpha = activation_layer->parameter();
+        } else {
+            throw std::runtime_error("Checkpoint: unsupported layer type " + std::string(typeid(layer).name()));
+        }
+        return record;
+    }
+
+    std::unique_ptr<Layer> make_layer(const LayerRecord& record) {
+        int input_size = static_cast<int>(record.input_size);
+        int output_size = static_cast<int>(record.output_size);
+        auto kind = static_cast<kernels::Activation>(record.activation);
+        ImageShape image{record.height, record.width, record.channels};
+        switch (static_cast<LayerType>(record.type)) {
+            case LayerType::Dense:
+                return std::make_unique<DenseLayer>(input_size, output_size);
+            case LayerType::DenseActivation:
+                return std::make_unique<DenseActivation>(input_size, output_size, kind, record.alpha);
+            case LayerType::Activation:
+                return make_activation(kind, record.alpha);
+            case LayerType::Softmax:
+                return std::make_unique<activation::Softmax>();
+            case LayerType::Conv2D:
+                return std::make_unique<Conv2DLayer>(image, record.filters, record.window, record.stride, record.padding);
+            case LayerType::MaxPool2D:
+                return std::make_unique<MaxPool2D>(image, record.window, record.stride);
+            case LayerType::Flatten:
+                return std::make_unique<Flatten>(image);
+        }
+        throw std::runtime_error("Checkpoint: unknown layer type " + std::to_string(record.type));
+    }
+
+    bool same_layer(const LayerRecord& a, const LayerRecord& b) {
+        return a.type == b.type && a.activation == b.activation && a.alpha == b.alpha
+            && a.input_size == b.input_size && a.output_size == b.output_size
+            && a.height == b.height && a.width == b.width && a.channels == b.channels && a.filters == b.filters
+            && a.window == b.window && a.stride == b.stride && a.padding == b.padding;
+    }
+
+    void serialize(const std::vector<std::unique_ptr<Layer>>& layers, const State& state, std::vector<char>& out) {
+        std::size_t blob_bytes = state.parameter_count * sizeof(float);
+        std::size_t offset = parameters_offset(layers.size());
+        // arena sizes are multiples of the alignment, so every blob stays aligned
+        out.assign(offset + blob_bytes * (1 + state.optimizer.size()), 0);
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.layer_count = static_cast<uint32_t>(layers.size());
+        header.parameter_count = state.parameter_count;
+        header.optimizer_buffers = static_cast<uint32_t>(state.optimizer.size());
+        header.epoch = state.epoch;
+        header.optimizer_steps = state.optimizer_steps;
+        header.dynamic_lr = state.dynamic_lr;
+        std::memcpy(out.data(), &header, sizeof(header));
+
+        for (std::size_t i = 0; i < layers.size(); i++) {
+            LayerRecord record = describe(*layers[i]);
+            std::memcpy(out.data() + sizeof(Header) + i * sizeof(LayerRecord), &record, sizeof(record));
+        }
+
+        std::memcpy(out.data() + offset, state.parameters, blob_bytes);
+        for (auto buffer : state.optimizer) {
+            offset += blob_bytes;
+            std::memcpy(out.data() + offset, buffer, blob_bytes);
+        }
+    }
+
+    Reader::Reader(const std::string& path)
+        : file(std::make_shared<MappedFile>(path, true))
+    {
+        if (file->size() < sizeof(Header)) {
+            throw std::runtime_error("Checkpoint: " + path + " is too small.");
+        }
+        std::memcpy(&file_header, file->data(), sizeof(Header));
+        if (std::memcmp(file_header.magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Checkpoint: " + path + " is not a checkpoint.");
+        }
+        if (file_header.version != version) {
+            throw std::runtime_error("Checkpoint: " + path + " has version " + std::to_string(file_header.version)
+                                     + ", expected " + std::to_string(version));
+        }
+        std::size_t expected = parameters_offset(file_header.layer_count)
+            + file_header.parameter_count * sizeof(float) * (1 + file_header.optimizer_buffers);
+        if (file->size() < expected) {
+            throw std::runtime_error("Checkpoint: " + path + " is truncated.");
+        }
+    }
+
+    std::vector<LayerRecord> Reader::layers() const {
+        std::vector<LayerRecord> records(file_header.layer_count);
+        std::memcpy(records.data(), file->data() + sizeof(Header), records.size() * sizeof(LayerRecord));
+        return records;
+    }
+
+    float* Reader::parameters() {
+        return reinterpret_cast<float*>(file->mutable_data() + parameters_offset(file_header.layer_count));
+    }
+
+    const float* Reader::optimizer_buffer(std::size_t index) const {
+        std::size_t offset = parameters_offset(file_header.layer_count)
+            + (index + 1) * file_header.parameter_count * sizeof(float);
+        return reinterpret_cast<const float*>(file->data() + offset);
+    }
+
+    AsyncWriter::AsyncWriter(std::string path)
+        : path(std::move(path)), writer(&AsyncWriter::run, this) {}
+
+    AsyncWriter::~AsyncWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_cv.notify_one();
+        writer.join();
+    }
+
+    void AsyncWriter::submit(std::vector<char>& bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(pending, bytes);
+            has_pending = true;
+        }
+        work_cv.notify_one();
+    }
+
+    void AsyncWriter::flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_cv.wait(lock, [this] { return !has_pending && !writing; });
+    }
+
+    void AsyncWriter::run() {
+        std::vector<char> bytes;
+        std::string temporary = path + ".tmp";
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_cv.wait(lock, [this] { return has_pending || stopping; });
+                // pending checkpoints are still written on shutdown
+                if (!has_pending) {
+                    return;
+                }
+                std::swap(bytes, pending);
+                has_pending = false;
+                writing = true;
+            }
+
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            out.close();
+            if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+                std::cerr << "Checkpoint: unable to write " << path << std::endl;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                writing = false;
+            }
+            idle_cv.notify_all();
+        }
+    }
+}
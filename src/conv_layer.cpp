@@ -0,0 +1,266 @@
+#include "conv_layer.hpp"
+
+namespace {
+    // im2col block of one GEMM call, sized to stay in L2 through the GEMM
+    constexpr size_t im2col_block_bytes = 256 * 1024;
+
+    template <class T>
+    auto row_block(T* data, size_t rows, size_t cols) {
+        return xt::adapt(data, rows * cols, xt::no_ownership(), std::array<size_t, 2>{rows, cols});
+    }
+
+    size_t output_extent(size_t input, size_t window, size_t stride, size_t padding) {
+        if (input + 2 * padding < window) {
+            throw std::runtime_error("Image layer: window of " + std::to_string(window)
+                                     + " larger than the padded input of " + std::to_string(input + 2 * padding) + ".");
+        }
+        return (input + 2 * padding - window) / stride + 1;
+    }
+
+    void check_width(const char* layer, const ImageShape& shape, size_t input_size) {
+        if (input_size != shape.size()) {
+            throw std::runtime_error(std::string(layer) + " expects " + std::to_string(shape.height) + "x"
+                                     + std::to_string(shape.width) + "x" + std::to_string(shape.channels)
+                                     + " images (" + std::to_string(shape.size()) + " features), got "
+                                     + std::to_string(input_size) + ".");
+        }
+    }
+}
+
+Conv2DLayer::Conv2DLayer(ImageShape input_shape, std::size_t filters, std::size_t kernel_size,
+                         std::size_t stride, std::size_t padding)
+    : input_shape(input_shape), kernel_size(kernel_size), stride(stride), padding(padding),
+      weights(filters, kernel_size * kernel_size * input_shape.channels), biases(1, filters)
+{
+    if (filters == 0 || kernel_size == 0 || stride == 0) {
+        throw std::runtime_error("Conv2DLayer: filters, kernel size and stride must be >= 1.");
+    }
+    output_shape = {output_extent(input_shape.height, kernel_size, stride, padding),
+                    output_extent(input_shape.width, kernel_size, stride, padding), filters};
+
+    // DenseLayer's U(-1, 1) scaled by the fan-in, which is large for deep filters
+    float scale = 1.0f / std::sqrt(static_cast<float>(weights.cols));
+    auto w = weights.values();
+    w = xt::random::rand({weights.rows, weights.cols}, -scale, scale);
+}
+
+std::size_t Conv2DLayer::output_size(std::size_t input_size) const {
+    check_width("Conv2DLayer", input_shape, input_size);
+    return output_shape.size();
+}
+
+double Conv2DLayer::flops(std::size_t rows, std::size_t input_size, bool backward) const {
+    double gemm = 2.0 * rows * output_shape.height * output_shape.width * weights.rows * weights.cols;
+    return (backward ? 2.0 * gemm : gemm) + static_cast<double>(rows) * output_shape.size();
+}
+
+std::unique_ptr<Layer> Conv2DLayer::replicate() const {
+    return std::make_unique<Conv2DLayer>(input_shape, weights.rows, kernel_size, stride, padding);
+}
+
+std::size_t Conv2DLayer::block_images() const {
+    size_t image_bytes = output_shape.height * output_shape.width * weights.cols * sizeof(float);
+    return std::max<size_t>(1, im2col_block_bytes / image_bytes);
+}
+
+void Conv2DLayer::im2col(const float* images, std::size_t n_images, float* columns) const {
+    size_t channels = input_shape.channels;
+    for (size_t n = 0; n < n_images; n++) {
+        const float* image = images + n * input_shape.size();
+        for (size_t oy = 0; oy < output_shape.height; oy++) {
+            for (size_t ox = 0; ox < output_shape.width; ox++) {
+                for (size_t ky = 0; ky < kernel_size; ky++) {
+                    // padding rows and columns read as zero
+                    long iy = static_cast<long>(oy * stride + ky) - static_cast<long>(padding);
+                    for (size_t kx = 0; kx < kernel_size; kx++, columns += channels) {
+                        long ix = static_cast<long>(ox * stride + kx) - static_cast<long>(padding);
+                        if (iy < 0 || ix < 0 || iy >= static_cast<long>(input_shape.height) || ix >= static_cast<long>(input_shape.width)) {
+                            std::fill_n(columns, channels, 0.0f);
+                        } else {
+                            std::copy_n(image + (iy * input_shape.width + ix) * channels, channels, columns);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Conv2DLayer::col2im(const float* columns, std::size_t n_images, float* images) const {
+    size_t channels = input_shape.channels;
+    std::fill_n(images, n_images * input_shape.size(), 0.0f);
+    for (size_t n = 0; n < n_images; n++) {
+        float* image = images + n * input_shape.size();
+        for (size_t oy = 0; oy < output_shape.height; oy++) {
+            for (size_t ox = 0; ox < output_shape.width; ox++) {
+                for (size_t ky = 0; ky < kernel_size; ky++) {
+                    long iy = static_cast<long>(oy * stride + ky) - static_cast<long>(padding);
+                    for (size_t kx = 0; kx < kernel_size; kx++, columns += channels) {
+                        long ix = static_cast<long>(ox * stride + kx) - static_cast<long>(padding);
+                        if (iy < 0 || ix < 0 || iy >= static_cast<long>(input_shape.height) || ix >= static_cast<long>(input_shape.width)) {
+                            continue;
+                        }
+                        float* pixel = image + (iy * input_shape.width + ix) * channels;
+                        for (size_t c = 0; c < channels; c++) {
+                            pixel[c] += columns[c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Conv2DLayer::forward(const Matrix& inputs, Matrix& outputs) {
+    size_t batch_size = inputs.shape()[0];
+    size_t patch = weights.cols;
+    size_t filters = weights.rows;
+    size_t pixels = output_shape.height * output_shape.width;
+    size_t block = block_images();
+
+    // per thread so concurrent workers never share it
+    thread_local std::vector<float> columns;
+    columns.resize(std::min(block, batch_size) * pixels * patch);
+
+    for (size_t start = 0; start < batch_size; start += block) {
+        size_t n_images = std::min(block, batch_size - start);
+        size_t rows = n_images * pixels;
+        im2col(inputs.data() + start * input_shape.size(), n_images, columns.data());
+
+        // one row per output pixel: (pixels, filters) is the NHWC output itself
+        float* y = outputs.data() + start * output_shape.size();
+        auto y_block = row_block(y, rows, filters);
+        xt::blas::gemm(row_block(columns.data(), rows, patch), weights.values(), y_block, false, true);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t f = 0; f < filters; f++) {
+                y[i * filters + f] += biases.value[f];
+            }
+        }
+    }
+}
+
+void Conv2DLayer::backward(const Matrix& inputs, const Matrix& outputs,
+                           const Matrix& upstream_gradient, Matrix& downstream_gradient) {
+    size_t batch_size = inputs.shape()[0];
+    size_t patch = weights.cols;
+    size_t filters = weights.rows;
+    size_t pixels = output_shape.height * output_shape.width;
+    size_t block = block_images();
+
+    // the unrolled inputs are rebuilt rather than kept from forward
+    thread_local std::vector<float> columns;
+    thread_local std::vector<float> column_gradient;
+    columns.resize(std::min(block, batch_size) * pixels * patch);
+    column_gradient.resize(columns.size());
+
+    auto weights_gradient = weights.gradients();
+    for (size_t start = 0; start < batch_size; start += block) {
+        size_t n_images = std::min(block, batch_size - start);
+        size_t rows = n_images * pixels;
+        im2col(inputs.data() + start * input_shape.size(), n_images, columns.data());
+
+        const float* dy = upstream_gradient.data() + start * output_shape.size();
+        auto dy_block = row_block(dy, rows, filters);
+        xt::blas::gemm(dy_block, row_block(columns.data(), rows, patch), weights_gradient, true, false, 1.0f, 1.0f);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t f = 0; f < filters; f++) {
+                biases.gradient[f] += dy[i * filters + f];
+            }
+        }
+
+        auto dcolumns = row_block(column_gradient.data(), rows, patch);
+        xt::blas::gemm(dy_block, weights.values(), dcolumns);
+        col2im(column_gradient.data(), n_images, downstream_gradient.data() + start * input_shape.size());
+    }
+}
+
+MaxPool2D::MaxPool2D(ImageShape input_shape, std::size_t pool, std::size_t stride)
+    : input_shape(input_shape), pool(pool), stride(stride == 0 ? pool : stride)
+{
+    if (pool == 0) {
+        throw std::runtime_error("MaxPool2D: the pool size must be >= 1.");
+    }
+    output_shape = {output_extent(input_shape.height, pool, this->stride, 0),
+                    output_extent(input_shape.width, pool, this->stride, 0), input_shape.channels};
+}
+
+std::size_t MaxPool2D::output_size(std::size_t input_size) const {
+    check_width("MaxPool2D", input_shape, input_size);
+    return output_shape.size();
+}
+
+double MaxPool2D::flops(std::size_t rows, std::size_t input_size, bool backward) const {
+    return static_cast<double>(rows) * output_shape.size() * pool * pool;
+}
+
+void MaxPool2D::forward(const Matrix& inputs, Matrix& outputs) {
+    size_t batch_size = inputs.shape()[0];
+    size_t channels = input_shape.channels;
+
+    for (size_t n = 0; n < batch_size; n++) {
+        const float* image = inputs.data() + n * input_shape.size();
+        float* out = outputs.data() + n * output_shape.size();
+        for (size_t oy = 0; oy < output_shape.height; oy++) {
+            for (size_t ox = 0; ox < output_shape.width; ox++, out += channels) {
+                // channels innermost: contiguous in NHWC, so the max vectorizes
+                std::fill_n(out, channels, -std::numeric_limits<float>::infinity());
+                for (size_t ky = 0; ky < pool; ky++) {
+                    for (size_t kx = 0; kx < pool; kx++) {
+                        const float* pixel = image + ((oy * stride + ky) * input_shape.width + ox * stride + kx) * channels;
+                        for (size_t c = 0; c < channels; c++) {
+                            out[c] = std::max(out[c], pixel[c]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void MaxPool2D::backward(const Matrix& inputs, const Matrix& outputs,
+                         const Matrix& upstream_gradient, Matrix& downstream_gradient) {
+    size_t batch_size = inputs.shape()[0];
+    size_t channels = input_shape.channels;
+    std::fill(downstream_gradient.begin(), downstream_gradient.end(), 0.0f);
+
+    // the argmax comes from the inputs alone: mixed precision hands back
+    // bf16-rounded inputs next to exact outputs, which never compare equal
+    for (size_t n = 0; n < batch_size; n++) {
+        const float* image = inputs.data() + n * input_shape.size();
+        float* dx = downstream_gradient.data() + n * input_shape.size();
+        const float* dy = upstream_gradient.data() + n * output_shape.size();
+        for (size_t o = 0; o < output_shape.height * output_shape.width; o++) {
+            size_t oy = o / output_shape.width;
+            size_t ox = o % output_shape.width;
+            for (size_t c = 0; c < channels; c++) {
+                // the first input holding the max takes the whole gradient
+                size_t best = (oy * stride * input_shape.width + ox * stride) * channels + c;
+                for (size_t ky = 0; ky < pool; ky++) {
+                    for (size_t kx = 0; kx < pool; kx++) {
+                        size_t offset = ((oy * stride + ky) * input_shape.width + ox * stride + kx) * channels + c;
+                        if (image[offset] > image[best]) {
+                            best = offset;
+                        }
+                    }
+                }
+                dx[best] += dy[o * channels + c];
+            }
+        }
+    }
+}
+
+std::size_t Flatten::output_size(std::size_t input_size) const {
+    check_width("Flatten", input_shape, input_size);
+    return input_size;
+}
+
+void Flatten::forward(const Matrix& inputs, Matrix& outputs) {
+    if (&inputs != &outputs) {
+        std::copy(inputs.cbegin(), inputs.cend(), outputs.begin());
+    }
+}
+
+void Flatten::backward(const Matrix& inputs, const Matrix& outputs,
+                       const Matrix& upstream_gradient, Matrix& downstream_gradient) {
+    std::copy(upstream_gradient.cbegin(), upstream_gradient.cend(), downstream_gradient.begin());
+}
@@ -0,0 +1,8 @@
+// Compiled with -mavx2 -mfma, only reached after a runtime CPU check.
+#include "activation_simd.hpp"
+
+namespace kernels::detail {
+    const ActivationKernels* avx2_kernels() {
+        return kernel_table<Avx2>;
+    }
+}
\ No newline at end of file
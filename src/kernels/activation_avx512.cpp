@@ -0,0 +1,8 @@
+// Compiled with -mavx512f -mavx512dq, only reached after a runtime CPU check.
+#include "activation_simd.hpp"
+
+namespace kernels::detail {
+    const ActivationKernels* avx512_kernels() {
+        return kernel_table<Avx512>;
+    }
+}
\ No newline at end of file
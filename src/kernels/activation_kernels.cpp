@@ -0,0 +1,47 @@
+#include "activation_simd.hpp"
+#include <stdexcept>
+
+
+namespace kernels {
+
+    Isa detected_isa() {
+        static const Isa isa = [] {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+                return Isa::AVX512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return Isa::AVX2;
+            }
+            return Isa::Scalar;
+        }();
+        return isa;
+    }
+
+    const char* isa_name(Isa isa) {
+        switch (isa) {
+            case Isa::AVX512: return "avx512";
+            case Isa::AVX2: return "avx2";
+            default: return "scalar";
+        }
+    }
+
+    const ActivationKernels& activation_kernels(Activation kind) {
+        return activation_kernels(kind, detected_isa());
+    }
+
+    const ActivationKernels& activation_kernels(Activation kind, Isa isa) {
+        if (static_cast<int>(isa) > static_cast<int>(detected_isa())) {
+            throw std::runtime_error(std::string("Activation kernels: ") + isa_name(isa)
+                                     + " is not supported by this CPU.");
+        }
+
+        const ActivationKernels* table = kernel_table<Scalar>;
+        if (isa == Isa::AVX512) {
+            table = detail::avx512_kernels();
+        } else if (isa == Isa::AVX2) {
+            table = detail::avx2_kernels();
+        }
+        return table[static_cast<int>(kind)];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,304 @@
+#ifndef __ACTIVATION_SIMD_HPP__
+#define __ACTIVATION_SIMD_HPP__
+
+// Activation math written once against a small register interface and
+// instantiated per ISA by activation_kernels.cpp (Scalar), activation_avx2.cpp
+// and activation_avx512.cpp. Everything here has internal linkage so each
+// translation unit keeps the copy compiled with its own target flags.
+
+#include "kernels/activation_kernels.hpp"
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+namespace {
+
+struct Scalar {
+    using reg = float;
+    using mask = bool;
+    static constexpr std::size_t width = 1;
+
+    static reg load(const float* p) { return *p; }
+    static void store(float* p, reg v) { *p = v; }
+    static reg set1(float v) { return v; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    static reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+    static reg fnmadd(reg a, reg b, reg c) { return c - a * b; }
+    static reg min(reg a, reg b) { return a < b ? a : b; }
+    static reg max(reg a, reg b) { return a > b ? a : b; }
+    static reg abs(reg a) { return std::fabs(a); }
+    static reg copysign(reg magnitude, reg sign) { return std::copysign(magnitude, sign); }
+    static reg round(reg a) { return std::nearbyint(a); }
+    // a * 2^n for integral n in [-126, 127]
+    static reg ldexp(reg a, reg n) {
+        auto bits = std::bit_cast<std::int32_t>(a) + (static_cast<std::int32_t>(n) << 23);
+        return std::bit_cast<float>(bits);
+    }
+    static mask lt(reg a, reg b) { return a < b; }
+    static mask gt(reg a, reg b) { return a > b; }
+    static mask ge(reg a, reg b) { return a >= b; }
+    static reg select(mask m, reg t, reg f) { return m ? t : f; }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+struct Avx2 {
+    using reg = __m256;
+    using mask = __m256;
+    static constexpr std::size_t width = 8;
+
+    static reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(float v) { return _mm256_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static reg fnmadd(reg a, reg b, reg c) { return _mm256_fnmadd_ps(a, b, c); }
+    static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static reg copysign(reg magnitude, reg sign) {
+        const reg sign_bit = _mm256_set1_ps(-0.0f);
+        return _mm256_or_ps(_mm256_andnot_ps(sign_bit, magnitude), _mm256_and_ps(sign_bit, sign));
+    }
+    static reg round(reg a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static reg ldexp(reg a, reg n) {
+        __m256i exponent = _mm256_slli_epi32(_mm256_cvtps_epi32(n), 23);
+        return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(a), exponent));
+    }
+    static mask lt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static mask gt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static mask ge(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static reg select(mask m, reg t, reg f) { return _mm256_blendv_ps(f, t, m); }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct Avx512 {
+    using reg = __m512;
+    using mask = __mmask16;
+    static constexpr std::size_t width = 16;
+
+    static reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg set1(float v) { return _mm512_set1_ps(v); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static reg fnmadd(reg a, reg b, reg c) { return _mm512_fnmadd_ps(a, b, c); }
+    static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+    static reg abs(reg a) { return _mm512_abs_ps(a); }
+    static reg copysign(reg magnitude, reg sign) {
+        const __m512i sign_bit = _mm512_set1_epi32(0x80000000);
+        // (magnitude & ~sign_bit) | (sign & sign_bit)
+        return _mm512_castsi512_ps(_mm512_ternarylogic_epi32(
+            sign_bit, _mm512_castps_si512(magnitude), _mm512_castps_si512(sign), 0xAC));
+    }
+    static reg round(reg a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static reg ldexp(reg a, reg n) { return _mm512_scalef_ps(a, n); }
+    static mask lt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static mask gt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static mask ge(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static reg select(mask m, reg t, reg f) { return _mm512_mask_blend_ps(m, f, t); }
+};
+#endif
+
+// Cephes expf: e^x = 2^n * e^r with n = round(x / ln2) and |r| <= ln2 / 2, ln2
+// split in two parts so r stays exact, then a degree 5 polynomial for e^r.
+template <class V>
+inline typename V::reg exp(typename V::reg x) {
+    using reg = typename V::reg;
+    x = V::min(V::max(x, V::set1(-86.0f)), V::set1(88.0f));
+    reg n = V::round(V::mul(x, V::set1(1.44269504088896341f)));
+    reg r = V::fnmadd(n, V::set1(0.693359375f), x);
+    r = V::fnmadd(n, V::set1(-2.12194440e-4f), r);
+
+    reg p = V::set1(1.9875691500e-4f);
+    p = V::fmadd(p, r, V::set1(1.3981999507e-3f));
+    p = V::fmadd(p, r, V::set1(8.3334519073e-3f));
+    p = V::fmadd(p, r, V::set1(4.1665795894e-2f));
+    p = V::fmadd(p, r, V::set1(1.6666665459e-1f));
+    p = V::fmadd(p, r, V::set1(5.0000001201e-1f));
+    p = V::fmadd(p, V::mul(r, r), V::add(r, V::set1(1.0f)));
+    return V::ldexp(p, n);
+}
+
+// Cephes tanhf odd polynomial below |x| = 0.625, where 1 - 2 / (e^2x + 1)
+// would lose precision to cancellation; the exp form above it.
+template <class V>
+inline typename V::reg tanh(typename V::reg x) {
+    using reg = typename V::reg;
+    reg ax = V::abs(x);
+
+    reg z = V::mul(x, x);
+    reg p = V::set1(-5.70498872745e-3f);
+    p = V::fmadd(p, z, V::set1(2.06390887954e-2f));
+    p = V::fmadd(p, z, V::set1(-5.37397155531e-2f));
+    p = V::fmadd(p, z, V::set1(1.33314422036e-1f));
+    p = V::fmadd(p, z, V::set1(-3.33332819422e-1f));
+    reg small = V::fmadd(V::mul(p, z), x, x);
+
+    reg e = exp<V>(V::add(ax, ax));
+    reg large = V::sub(V::set1(1.0f), V::div(V::set1(2.0f), V::add(e, V::set1(1.0f))));
+    large = V::copysign(large, x);
+
+    return V::select(V::lt(ax, V::set1(0.625f)), small, large);
+}
+
+struct IdentityOp {
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float) { return x; }
+    template <class V>
+    static typename V::reg backward(typename V::reg, typename V::reg, typename V::reg dy, float) { return dy; }
+};
+
+struct SigmoidOp {
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float) {
+        auto one = V::set1(1.0f);
+        return V::div(one, V::add(one, exp<V>(V::sub(V::set1(0.0f), x))));
+    }
+    template <class V>
+    static typename V::reg backward(typename V::reg, typename V::reg y, typename V::reg dy, float) {
+        return V::mul(dy, V::mul(y, V::sub(V::set1(1.0f), y)));
+    }
+};
+
+struct TanhOp {
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float) { return tanh<V>(x); }
+    template <class V>
+    static typename V::reg backward(typename V::reg, typename V::reg y, typename V::reg dy, float) {
+        return V::mul(dy, V::fnmadd(y, y, V::set1(1.0f)));
+    }
+};
+
+struct ReLUOp {
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float) { return V::max(x, V::set1(0.0f)); }
+    template <class V>
+    static typename V::reg backward(typename V::reg x, typename V::reg, typename V::reg dy, float) {
+        return V::select(V::gt(x, V::set1(0.0f)), dy, V::set1(0.0f));
+    }
+};
+
+struct LeakyReLUOp {
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float alpha) {
+        return V::select(V::ge(x, V::set1(0.0f)), x, V::mul(x, V::set1(alpha)));
+    }
+    template <class V>
+    static typename V::reg backward(typename V::reg x, typename V::reg, typename V::reg dy, float alpha) {
+        return V::select(V::gt(x, V::set1(0.0f)), dy, V::mul(dy, V::set1(alpha)));
+    }
+};
+
+struct ELUOp {
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float alpha) {
+        auto negative = V::mul(V::set1(alpha), V::sub(exp<V>(x), V::set1(1.0f)));
+        return V::select(V::ge(x, V::set1(0.0f)), x, negative);
+    }
+    template <class V>
+    static typename V::reg backward(typename V::reg x, typename V::reg y, typename V::reg dy, float alpha) {
+        // alpha * e^x == y + alpha on the negative side
+        return V::select(V::ge(x, V::set1(0.0f)), dy, V::mul(dy, V::add(y, V::set1(alpha))));
+    }
+};
+
+// tanh approximation: 0.5 x (1 + tanh(sqrt(2 / pi) (x + 0.044715 x^3)))
+struct GELUOp {
+    static constexpr float sqrt_2_over_pi = 0.7978845608028654f;
+
+    template <class V>
+    static typename V::reg inner_tanh(typename V::reg x) {
+        auto x2 = V::mul(x, x);
+        auto u = V::mul(V::mul(V::set1(sqrt_2_over_pi), x), V::fmadd(V::set1(0.044715f), x2, V::set1(1.0f)));
+        return tanh<V>(u);
+    }
+    template <class V>
+    static typename V::reg forward(typename V::reg x, float) {
+        auto half_x = V::mul(V::set1(0.5f), x);
+        return V::fmadd(half_x, inner_tanh<V>(x), half_x);
+    }
+    template <class V>
+    static typename V::reg backward(typename V::reg x, typename V::reg, typename V::reg dy, float) {
+        auto half = V::set1(0.5f);
+        auto t = inner_tanh<V>(x);
+        auto du = V::mul(V::set1(sqrt_2_over_pi), V::fmadd(V::set1(0.134145f), V::mul(x, x), V::set1(1.0f)));
+        // 0.5 (1 + t) + 0.5 x (1 - t^2) du
+        auto derivative = V::fmadd(V::mul(V::mul(half, x), V::fnmadd(t, t, V::set1(1.0f))), du,
+                                   V::fmadd(half, t, half));
+        return V::mul(dy, derivative);
+    }
+};
+
+template <class V, class Op>
+void forward_kernel(const float* x, float* y, std::size_t n, float alpha) {
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        V::store(y + i, Op::template forward<V>(V::load(x + i), alpha));
+    }
+    for (; i < n; ++i) {
+        y[i] = Op::template forward<Scalar>(x[i], alpha);
+    }
+}
+
+template <class V, class Op>
+void forward_bias_kernel(const float* x, const float* bias, float* y, std::size_t n, float alpha) {
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        V::store(y + i, Op::template forward<V>(V::add(V::load(x + i), V::load(bias + i)), alpha));
+    }
+    for (; i < n; ++i) {
+        y[i] = Op::template forward<Scalar>(x[i] + bias[i], alpha);
+    }
+}
+
+template <class V, class Op>
+void backward_kernel(const float* x, const float* y, const float* dy, float* dx, std::size_t n, float alpha) {
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) {
+        V::store(dx + i, Op::template backward<V>(V::load(x + i), V::load(y + i), V::load(dy + i), alpha));
+    }
+    for (; i < n; ++i) {
+        dx[i] = Op::template backward<Scalar>(x[i], y[i], dy[i], alpha);
+    }
+}
+
+// Indexed by Activation.
+template <class V>
+constexpr ActivationKernels kernel_table[] = {
+    {forward_kernel<V, IdentityOp>, backward_kernel<V, IdentityOp>, forward_bias_kernel<V, IdentityOp>},
+    {forward_kernel<V, SigmoidOp>, backward_kernel<V, SigmoidOp>, forward_bias_kernel<V, SigmoidOp>},
+    {forward_kernel<V, TanhOp>, backward_kernel<V, TanhOp>, forward_bias_kernel<V, TanhOp>},
+    {forward_kernel<V, ReLUOp>, backward_kernel<V, ReLUOp>, forward_bias_kernel<V, ReLUOp>},
+    {forward_kernel<V, LeakyReLUOp>, backward_kernel<V, LeakyReLUOp>, forward_bias_kernel<V, LeakyReLUOp>},
+    {forward_kernel<V, ELUOp>, backward_kernel<V, ELUOp>, forward_bias_kernel<V, ELUOp>},
+    {forward_kernel<V, GELUOp>, backward_kernel<V, GELUOp>, forward_bias_kernel<V, GELUOp>},
+};
+
+static_assert(std::size(kernel_table<Scalar>) == static_cast<std::size_t>(Activation::Count));
+
+}
+
+namespace detail {
+    const ActivationKernels* avx2_kernels();
+    const ActivationKernels* avx512_kernels();
+}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "kernels/bf16.hpp"
+#include <stdexcept>
+#include <string>
+
+
+namespace kernels {
+    namespace detail {
+        Bf16GemmKernel avx2_bf16_gemm();
+        Bf16GemmKernel avx512_bf16_gemm();
+    }
+
+    namespace {
+        void bf16_gemm_scalar(const bf16* a, const bf16* w, float* c,
+                              std::size_t rows, std::size_t cols, std::size_t k_padded, std::size_t ldc) {
+            for (std::size_t i = 0; i < rows; i++) {
+                for (std::size_t j = 0; j < cols; j++) {
+                    float sum = 0.0f;
+                    for (std::size_t k = 0; k < k_padded; k++) {
+                        sum += from_bf16(a[i * k_padded + k]) * from_bf16(w[j * k_padded + k]);
+                    }
+                    c[i * ldc + j] = sum;
+                }
+            }
+        }
+    }
+
+    Bf16Isa detected_bf16_isa() {
+        static const Bf16Isa isa = [] {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bf16")) {
+                return Bf16Isa::AVX512BF16;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return Bf16Isa::AVX2;
+            }
+            return Bf16Isa::Scalar;
+        }();
+        return isa;
+    }
+
+    const char* bf16_isa_name(Bf16Isa isa) {
+        switch (isa) {
+            case Bf16Isa::AVX512BF16: return "avx512-bf16";
+            case Bf16Isa::AVX2: return "avx2";
+            default: return "scalar";
+        }
+    }
+
+    Bf16GemmKernel bf16_gemm_kernel() {
+        return bf16_gemm_kernel(detected_bf16_isa());
+    }
+
+    Bf16GemmKernel bf16_gemm_kernel(Bf16Isa isa) {
+        if (static_cast<int>(isa) > static_cast<int>(detected_bf16_isa())) {
+            throw std::runtime_error(std::string("bf16 GEMM: ") + bf16_isa_name(isa)
+                                     + " is not supported by this CPU.");
+        }
+        if (isa == Bf16Isa::AVX512BF16) {
+            return detail::avx512_bf16_gemm();
+        } else if (isa == Bf16Isa::AVX2) {
+            return detail::avx2_bf16_gemm();
+        }
+        return bf16_gemm_scalar;
+    }
+
+    void to_bf16_rows(const float* __restrict x, bf16* __restrict y, std::size_t rows, std::size_t cols, std::size_t stride) {
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t j = 0; j < cols; j++) {
+                y[i * stride + j] = to_bf16(x[i * cols + j]);
+            }
+            for (std::size_t j = cols; j < stride; j++) {
+                y[i * stride + j] = 0;
+            }
+        }
+    }
+
+    void from_bf16_rows(const bf16* __restrict x, float* __restrict y, std::size_t rows, std::size_t cols, std::size_t stride) {
+        for (std::size_t i = 0; i < rows; i++) {
+            for (std::size_t j = 0; j < cols; j++) {
+                y[i * cols + j] = from_bf16(x[i * stride + j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+// Compiled with -mavx2 -mfma, only reached after a runtime CPU check.
+#include "kernels/bf16.hpp"
+#include <immintrin.h>
+
+
+namespace kernels::detail {
+    namespace {
+        // 8 bf16 to 8 floats: bf16 is the upper half of the fp32
+        __m256 widen(const bf16* x) {
+            __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+            return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(half), 16));
+        }
+
+        float horizontal_sum(__m256 v) {
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+            return _mm_cvtss_f32(sum);
+        }
+
+        // R rows of a times C rows of w, 8 elements of k per step
+        template <int R, int C>
+        void block(const bf16* a, const bf16* w, float* c, std::size_t k_padded, std::size_t ldc) {
+            __m256 acc[R][C];
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    acc[r][j] = _mm256_setzero_ps();
+                }
+            }
+
+            for (std::size_t k = 0; k < k_padded; k += 8) {
+                __m256 wv[C];
+                for (int j = 0; j < C; j++) {
+                    wv[j] = widen(w + j * k_padded + k);
+                }
+                for (int r = 0; r < R; r++) {
+                    __m256 av = widen(a + r * k_padded + k);
+                    for (int j = 0; j < C; j++) {
+                        acc[r][j] = _mm256_fmadd_ps(av, wv[j], acc[r][j]);
+                    }
+                }
+            }
+
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    c[r * ldc + j] = horizontal_sum(acc[r][j]);
+                }
+            }
+        }
+
+        template <int R>
+        void row_block(const bf16* a, const bf16* w, float* c, std::size_t cols, std::size_t k_padded, std::size_t ldc) {
+            std::size_t j = 0;
+            for (; j + 3 <= cols; j += 3) {
+                block<R, 3>(a, w + j * k_padded, c + j, k_padded, ldc);
+            }
+            for (; j < cols; j++) {
+                block<R, 1>(a, w + j * k_padded, c + j, k_padded, ldc);
+            }
+        }
+
+        void bf16_gemm(const bf16* a, const bf16* w, float* c,
+                       std::size_t rows, std::size_t cols, std::size_t k_padded, std::size_t ldc) {
+            std::size_t i = 0;
+            for (; i + 4 <= rows; i += 4) {
+                row_block<4>(a + i * k_padded, w, c + i * ldc, cols, k_padded, ldc);
+            }
+            for (; i < rows; i++) {
+                row_block<1>(a + i * k_padded, w, c + i * ldc, cols, k_padded, ldc);
+            }
+        }
+    }
+
+    Bf16GemmKernel avx2_bf16_gemm() {
+        return bf16_gemm;
+    }
+}
@@ -0,0 +1,68 @@
+// Compiled with -mavx512f -mavx512bf16, only reached after a runtime CPU check.
+#include "kernels/bf16.hpp"
+#include <immintrin.h>
+
+
+namespace kernels::detail {
+    namespace {
+        __m512bh load(const bf16* x) {
+            return (__m512bh) _mm512_loadu_si512(x);
+        }
+
+        // R rows of a times C rows of w, 32 elements of k per vdpbf16ps
+        template <int R, int C>
+        void block(const bf16* a, const bf16* w, float* c, std::size_t k_padded, std::size_t ldc) {
+            __m512 acc[R][C];
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    acc[r][j] = _mm512_setzero_ps();
+                }
+            }
+
+            for (std::size_t k = 0; k < k_padded; k += 32) {
+                __m512bh wv[C];
+                for (int j = 0; j < C; j++) {
+                    wv[j] = load(w + j * k_padded + k);
+                }
+                for (int r = 0; r < R; r++) {
+                    __m512bh av = load(a + r * k_padded + k);
+                    for (int j = 0; j < C; j++) {
+                        acc[r][j] = _mm512_dpbf16_ps(acc[r][j], av, wv[j]);
+                    }
+                }
+            }
+
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    c[r * ldc + j] = _mm512_reduce_add_ps(acc[r][j]);
+                }
+            }
+        }
+
+        template <int R>
+        void row_block(const bf16* a, const bf16* w, float* c, std::size_t cols, std::size_t k_padded, std::size_t ldc) {
+            std::size_t j = 0;
+            for (; j + 4 <= cols; j += 4) {
+                block<R, 4>(a, w + j * k_padded, c + j, k_padded, ldc);
+            }
+            for (; j < cols; j++) {
+                block<R, 1>(a, w + j * k_padded, c + j, k_padded, ldc);
+            }
+        }
+
+        void bf16_gemm(const bf16* a, const bf16* w, float* c,
+                       std::size_t rows, std::size_t cols, std::size_t k_padded, std::size_t ldc) {
+            std::size_t i = 0;
+            for (; i + 4 <= rows; i += 4) {
+                row_block<4>(a + i * k_padded, w, c + i * ldc, cols, k_padded, ldc);
+            }
+            for (; i < rows; i++) {
+                row_block<1>(a + i * k_padded, w, c + i * ldc, cols, k_padded, ldc);
+            }
+        }
+    }
+
+    Bf16GemmKernel avx512_bf16_gemm() {
+        return bf16_gemm;
+    }
+}
@@ -0,0 +1,26 @@
+#include "kernels/gather.hpp"
+#include <cstring>
+
+
+namespace kernels {
+
+    void gather_rows(const float* __restrict src, std::size_t row_size, const std::size_t* __restrict indices,
+                     std::size_t count, float* __restrict dst) {
+        constexpr std::size_t lookahead = 8;
+
+        // one float per row (labels): a plain indexed load, no copy call per element
+        if (row_size == 1) {
+            for (std::size_t i = 0; i < count; i++) {
+                dst[i] = src[indices[i]];
+            }
+            return;
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            if (i + lookahead < count) {
+                __builtin_prefetch(src + indices[i + lookahead] * row_size);
+            }
+            std::memcpy(dst + i * row_size, src + indices[i] * row_size, row_size * sizeof(float));
+        }
+    }
+}
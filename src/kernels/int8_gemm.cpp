@@ -0,0 +1,76 @@
+#include "kernels/int8_gemm.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+
+namespace kernels {
+    namespace detail {
+        Int8GemmKernel avx2_int8_gemm();
+        Int8GemmKernel vnni_int8_gemm();
+    }
+
+    namespace {
+        void int8_gemm_scalar(const uint8_t* a, const int8_t* w, int32_t* c,
+                              std::size_t rows, std::size_t cols, std::size_t k_padded) {
+            for (std::size_t i = 0; i < rows; i++) {
+                for (std::size_t j = 0; j < cols; j++) {
+                    int32_t sum = 0;
+                    for (std::size_t k = 0; k < k_padded; k++) {
+                        sum += int32_t(a[i * k_padded + k]) * int32_t(w[j * k_padded + k]);
+                    }
+                    c[i * cols + j] = sum;
+                }
+            }
+        }
+    }
+
+    Int8Isa detected_int8_isa() {
+        static const Int8Isa isa = [] {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                && __builtin_cpu_supports("avx512vnni")) {
+                return Int8Isa::VNNI;
+            }
+            if (__builtin_cpu_supports("avx2")) {
+                return Int8Isa::AVX2;
+            }
+            return Int8Isa::Scalar;
+        }();
+        return isa;
+    }
+
+    const char* int8_isa_name(Int8Isa isa) {
+        switch (isa) {
+            case Int8Isa::VNNI: return "avx512-vnni";
+            case Int8Isa::AVX2: return "avx2";
+            default: return "scalar";
+        }
+    }
+
+    Int8GemmKernel int8_gemm_kernel() {
+        return int8_gemm_kernel(detected_int8_isa());
+    }
+
+    Int8GemmKernel int8_gemm_kernel(Int8Isa isa) {
+        if (static_cast<int>(isa) > static_cast<int>(detected_int8_isa())) {
+            throw std::runtime_error(std::string("Int8 GEMM: ") + int8_isa_name(isa)
+                                     + " is not supported by this CPU.");
+        }
+        if (isa == Int8Isa::VNNI) {
+            return detail::vnni_int8_gemm();
+        } else if (isa == Int8Isa::AVX2) {
+            return detail::avx2_int8_gemm();
+        }
+        return int8_gemm_scalar;
+    }
+
+    void quantize_activations(const float* __restrict x, uint8_t* __restrict q, std::size_t n,
+                              float inv_scale, float zero_point) {
+        // clamp in float, then round half up: vectorizes without a call to nearbyint
+        for (std::size_t i = 0; i < n; i++) {
+            float v = std::clamp(x[i] * inv_scale + zero_point, 0.0f, float(activation_qmax));
+            q[i] = static_cast<uint8_t>(v + 0.5f);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+// Compiled with -mavx2 -mfma, only reached after a runtime CPU check.
+#include "kernels/int8_gemm.hpp"
+#include <immintrin.h>
+
+
+namespace kernels::detail {
+    namespace {
+        int32_t horizontal_sum(__m256i v) {
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            return _mm_cvtsi128_si32(sum);
+        }
+
+        // R rows of a times C rows of w, 32 bytes of k per step: vpmaddubsw
+        // gives int16 pair sums (no saturation for a <= 127), vpmaddwd with
+        // ones widens them to int32
+        template <int R, int C>
+        void block(const uint8_t* a, const int8_t* w, int32_t* c, std::size_t cols, std::size_t k_padded) {
+            const __m256i ones = _mm256_set1_epi16(1);
+            __m256i acc[R][C];
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    acc[r][j] = _mm256_setzero_si256();
+                }
+            }
+
+            for (std::size_t k = 0; k < k_padded; k += 32) {
+                __m256i wv[C];
+                for (int j = 0; j < C; j++) {
+                    wv[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(w + j * k_padded + k));
+                }
+                for (int r = 0; r < R; r++) {
+                    __m256i av = _mm256_load_si256(reinterpret_cast<const __m256i*>(a + r * k_padded + k));
+                    for (int j = 0; j < C; j++) {
+                        __m256i pairs = _mm256_maddubs_epi16(av, wv[j]);
+                        acc[r][j] = _mm256_add_epi32(acc[r][j], _mm256_madd_epi16(pairs, ones));
+                    }
+                }
+            }
+
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    c[r * cols + j] = horizontal_sum(acc[r][j]);
+                }
+            }
+        }
+
+        template <int R>
+        void row_block(const uint8_t* a, const int8_t* w, int32_t* c, std::size_t cols, std::size_t k_padded) {
+            std::size_t j = 0;
+            for (; j + 4 <= cols; j += 4) {
+                block<R, 4>(a, w + j * k_padded, c + j, cols, k_padded);
+            }
+            for (; j < cols; j++) {
+                block<R, 1>(a, w + j * k_padded, c + j, cols, k_padded);
+            }
+        }
+
+        void int8_gemm(const uint8_t* a, const int8_t* w, int32_t* c,
+                       std::size_t rows, std::size_t cols, std::size_t k_padded) {
+            std::size_t i = 0;
+            for (; i + 2 <= rows; i += 2) {
+                row_block<2>(a + i * k_padded, w, c + i * cols, cols, k_padded);
+            }
+            if (i < rows) {
+                row_block<1>(a + i * k_padded, w, c + i * cols, cols, k_padded);
+            }
+        }
+    }
+
+    Int8GemmKernel avx2_int8_gemm() {
+        return int8_gemm;
+    }
+}
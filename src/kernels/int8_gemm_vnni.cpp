@@ -0,0 +1,64 @@
+// Compiled with -mavx512f -mavx512bw -mavx512vnni, only reached after a runtime CPU check.
+#include "kernels/int8_gemm.hpp"
+#include <immintrin.h>
+
+
+namespace kernels::detail {
+    namespace {
+        // R rows of a times C rows of w, 64 bytes of k per vpdpbusd
+        template <int R, int C>
+        void block(const uint8_t* a, const int8_t* w, int32_t* c, std::size_t cols, std::size_t k_padded) {
+            __m512i acc[R][C];
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    acc[r][j] = _mm512_setzero_si512();
+                }
+            }
+
+            for (std::size_t k = 0; k < k_padded; k += 64) {
+                __m512i wv[C];
+                for (int j = 0; j < C; j++) {
+                    wv[j] = _mm512_load_si512(w + j * k_padded + k);
+                }
+                for (int r = 0; r < R; r++) {
+                    __m512i av = _mm512_load_si512(a + r * k_padded + k);
+                    for (int j = 0; j < C; j++) {
+                        acc[r][j] = _mm512_dpbusd_epi32(acc[r][j], av, wv[j]);
+                    }
+                }
+            }
+
+            for (int r = 0; r < R; r++) {
+                for (int j = 0; j < C; j++) {
+                    c[r * cols + j] = _mm512_reduce_add_epi32(acc[r][j]);
+                }
+            }
+        }
+
+        template <int R>
+        void row_block(const uint8_t* a, const int8_t* w, int32_t* c, std::size_t cols, std::size_t k_padded) {
+            std::size_t j = 0;
+            for (; j + 4 <= cols; j += 4) {
+                block<R, 4>(a, w + j * k_padded, c + j, cols, k_padded);
+            }
+            for (; j < cols; j++) {
+                block<R, 1>(a, w + j * k_padded, c + j, cols, k_padded);
+            }
+        }
+
+        void int8_gemm(const uint8_t* a, const int8_t* w, int32_t* c,
+                       std::size_t rows, std::size_t cols, std::size_t k_padded) {
+            std::size_t i = 0;
+            for (; i + 4 <= rows; i += 4) {
+                row_block<4>(a + i * k_padded, w, c + i * cols, cols, k_padded);
+            }
+            for (; i < rows; i++) {
+                row_block<1>(a + i * k_padded, w, c + i * cols, cols, k_padded);
+            }
+        }
+    }
+
+    Int8GemmKernel vnni_int8_gemm() {
+        return int8_gemm;
+    }
+}
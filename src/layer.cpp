@@ -1,128 +1,333 @@
 #include "layer.hpp"
 
+namespace {
+    // Rows of the output tile handled per GEMM call in the fused epilogue,
+    // sized so the tile stays in L2 between the GEMM and the epilogue.
+    constexpr size_t epilogue_tile_bytes = 128 * 1024;
 
-DenseLayer::DenseLayer(int input_size, int output_size) {
-    weights = xt::random::rand({output_size, input_size}, -1.0f, 1.0f);
-    biases = xt::zeros<float>({output_size}); 
+    size_t tile_rows(size_t row_width) {
+        return std::max<size_t>(8, epilogue_tile_bytes / (row_width * sizeof(float)));
+    }
+
+    // (rows, cols) view over consecutive rows of a row-major buffer, no copy
+    template <class T>
+    auto row_block(T* data, size_t rows, size_t cols) {
+        return xt::adapt(data, rows * cols, xt::no_ownership(), std::array<size_t, 2>{rows, cols});
+    }
+
+    // sums[j] += sum_i values[i][j], the bias gradient of a dense layer
+    void add_column_sums(const float* values, size_t rows, size_t cols, float* sums) {
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                sums[j] += values[i * cols + j];
+            }
+        }
+    }
 }
 
-DenseLayer::DenseLayer(const xt::xarray<float>& weights, const xt::xarray<float>& biases) :
-    weights(weights), biases(biases) {}
+DenseLayer::DenseLayer(int input_size, int output_size)
+    : weights(output_size, input_size), biases(1, output_size)
+{
+    auto w = weights.values();
+    w = xt::random::rand({output_size, input_size}, -1.0f, 1.0f);
+}
 
-xt::xarray<float> DenseLayer::forward(const xt::xarray<float>& inputs) {
-    this->inputs = inputs;
-    auto transposed_weights = xt::transpose(weights);
-    return xt::linalg::dot(inputs, xt::transpose(weights)) + biases; 
+DenseLayer::DenseLayer(const Matrix& weights, const xt::xtensor<float, 1>& biases)
+    : weights(weights.shape()[0], weights.shape()[1]), biases(1, biases.size())
+{
+    std::copy(weights.cbegin(), weights.cend(), this->weights.value);
+    std::copy(biases.cbegin(), biases.cend(), this->biases.value);
 }
 
-xt::xarray<float> DenseLayer::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-    size_t batch_size = inputs.shape()[0];
-    
-    auto weights_gradient = xt::linalg::dot(xt::transpose(inputs), upstream_gradient);
-    auto biases_gradient = xt::sum(upstream_gradient, {0});
+std::size_t DenseLayer::output_size(std::size_t input_size) const {
+    if (input_size != weights.cols) {
+        throw std::runtime_error("DenseLayer expects " + std::to_string(weights.cols)
+                                 + " input features, got " + std::to_string(input_size) + ".");
+    }
+    return weights.rows;
+}
 
-    weights -= lr * xt::transpose(weights_gradient) / batch_size; 
-    biases -= lr * biases_gradient / batch_size;
+std::unique_ptr<Layer> DenseLayer::replicate() const {
+    return std::make_unique<DenseLayer>(static_cast<int>(weights.cols), static_cast<int>(weights.rows));
+}
 
-    return xt::linalg::dot(upstream_gradient, weights);
+double DenseLayer::flops(std::size_t rows, std::size_t input_size, bool backward) const {
+    double gemm = 2.0 * rows * weights.cols * weights.rows;
+    // backward runs two GEMMs, for the input and the weight gradients
+    return (backward ? 2.0 * gemm : gemm) + static_cast<double>(rows) * weights.rows;
 }
 
-namespace activation {
+void DenseLayer::forward(const Matrix& inputs, Matrix& outputs) {
+    forward_tiled(inputs, outputs, kernels::activation_kernels(kernels::Activation::Identity), 0.0f);
+}
 
-    float Sigmoid::activation_function(float weighted_sum) {
-        return 1.0 / (1.0 + std::exp(-weighted_sum));
+void DenseLayer::forward_tiled(const Matrix& inputs, Matrix& outputs,
+                               const kernels::ActivationKernels& epilogue, float alpha) const {
+    size_t batch_size = inputs.shape()[0];
+    size_t input_size = weights.cols;
+    size_t output_size = weights.rows;
+    size_t tile = tile_rows(output_size);
+
+    for (size_t start = 0; start < batch_size; start += tile) {
+        size_t rows = std::min(tile, batch_size - start);
+        float* y = outputs.data() + start * output_size;
+
+        // y = x . weights^T, transposed inside sgemm instead of materialized
+        auto y_tile = row_block(y, rows, output_size);
+        xt::blas::gemm(row_block(inputs.data() + start * input_size, rows, input_size), weights.values(), y_tile, false, true);
+        for (size_t i = 0; i < rows; i++) {
+            epilogue.forward_bias(y + i * output_size, biases.value, y + i * output_size, output_size, alpha);
+        }
     }
+}
 
-    xt::xarray<float> Sigmoid::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        return upstream_gradient * last_output * (1 - last_output);
-    }
+bool DenseLayer::forward_bf16(const Bf16Matrix& inputs, Matrix& outputs) {
+    forward_tiled_bf16(inputs, outputs, kernels::activation_kernels(kernels::Activation::Identity), 0.0f);
+    return true;
+}
 
-    
-    float Tanh::activation_function(float weighted_sum) {
-        return std::tanh(weighted_sum);
+void DenseLayer::forward_tiled_bf16(const Bf16Matrix& inputs, Matrix& outputs,
+                                    const kernels::ActivationKernels& epilogue, float alpha) {
+    size_t batch_size = inputs.shape()[0];
+    size_t k_padded = inputs.shape()[1];
+    size_t output_size = weights.rows;
+    size_t tile = tile_rows(output_size);
+    if (k_padded != kernels::bf16_padded(weights.cols)) {
+        throw std::runtime_error("DenseLayer: bf16 inputs must have rows of " + std::to_string(kernels::bf16_padded(weights.cols)) + " elements.");
     }
 
-    xt::xarray<float> Tanh::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        return upstream_gradient * (1 - xt::square(last_output));
+    // O(weights) per call against O(batch * weights) for the GEMM
+    weights_bf16.resize(output_size * k_padded);
+    kernels::to_bf16_rows(weights.value, weights_bf16.data(), output_size, weights.cols, k_padded);
+
+    for (size_t start = 0; start < batch_size; start += tile) {
+        size_t rows = std::min(tile, batch_size - start);
+        float* y = outputs.data() + start * output_size;
+        bf16_gemm(inputs.data() + start * k_padded, weights_bf16.data(), y, rows, output_size, k_padded, output_size);
+        for (size_t i = 0; i < rows; i++) {
+            epilogue.forward_bias(y + i * output_size, biases.value, y + i * output_size, output_size, alpha);
+        }
     }
+}
 
+void DenseLayer::backward(const Matrix& inputs, const Matrix& outputs,
+                          const Matrix& upstream_gradient, Matrix& downstream_gradient) {
+    xt::blas::gemm(upstream_gradient, weights.values(), downstream_gradient);
 
-    float ReLU::activation_function(float weighted_sum) {
-        return std::max((float)0.0f, weighted_sum);
+    auto weights_gradient = weights.gradients();
+    xt::blas::gemm(upstream_gradient, inputs, weights_gradient, true, false, 1.0f, 1.0f);
+    add_column_sums(upstream_gradient.data(), inputs.shape()[0], weights.rows, biases.gradient);
+}
+
+bool DenseLayer::forward_sparse(const CsrMatrix& inputs, Matrix& outputs) {
+    forward_csr(inputs, outputs, kernels::activation_kernels(kernels::Activation::Identity), 0.0f);
+    return true;
+}
+
+void DenseLayer::backward_sparse(const CsrMatrix& inputs, const Matrix& outputs, const Matrix& upstream_gradient) {
+    accumulate_csr_gradients(inputs, upstream_gradient.data());
+}
+
+void DenseLayer::forward_csr(const CsrMatrix& inputs, Matrix& outputs,
+                             const kernels::ActivationKernels& epilogue, float alpha) const {
+    size_t input_size = weights.cols;
+    size_t output_size = weights.rows;
+    if (inputs.cols != input_size) {
+        throw std::runtime_error("DenseLayer expects " + std::to_string(input_size)
+                                 + " input features, got " + std::to_string(inputs.cols) + ".");
     }
 
-    xt::xarray<float> ReLU::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        return upstream_gradient * xt::cast<float>(this->inputs > 0);
+    for (size_t i = 0; i < inputs.rows; i++) {
+        const uint32_t* columns = inputs.columns.data() + inputs.row_offsets[i];
+        const float* values = inputs.values.data() + inputs.row_offsets[i];
+        size_t nnz = inputs.row_offsets[i + 1] - inputs.row_offsets[i];
+        float* y = outputs.data() + i * output_size;
+        for (size_t o = 0; o < output_size; o++) {
+            // ascending columns: the reads move forward through the weight row
+            const float* w = weights.value + o * input_size;
+            float sum = 0.0f;
+            for (size_t k = 0; k < nnz; k++) {
+                sum += values[k] * w[columns[k]];
+            }
+            y[o] = sum;
+        }
+        epilogue.forward_bias(y, biases.value, y, output_size, alpha);
     }
+}
 
-    float LeakyReLU::activation_function(float weighted_sum) {
-        return weighted_sum >= 0 ? weighted_sum : 0.01f * weighted_sum;
+void DenseLayer::accumulate_csr_gradients(const CsrMatrix& inputs, const float* delta) {
+    size_t input_size = weights.cols;
+    size_t output_size = weights.rows;
+    for (size_t i = 0; i < inputs.rows; i++) {
+        const uint32_t* columns = inputs.columns.data() + inputs.row_offsets[i];
+        const float* values = inputs.values.data() + inputs.row_offsets[i];
+        size_t nnz = inputs.row_offsets[i + 1] - inputs.row_offsets[i];
+        const float* d = delta + i * output_size;
+        for (size_t o = 0; o < output_size; o++) {
+            // ReLU-like activations zero many deltas, those rows are skipped
+            if (d[o] == 0.0f) {
+                continue;
+            }
+            float* g = weights.gradient + o * input_size;
+            for (size_t k = 0; k < nnz; k++) {
+                g[columns[k]] += d[o] * values[k];
+            }
+        }
     }
+    add_column_sums(delta, inputs.rows, output_size, biases.gradient);
+}
 
-    xt::xarray<float> LeakyReLU::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        auto grad_mask = xt::cast<float>(this->inputs > 0);
-        return upstream_gradient * (grad_mask + 0.01f * (1 - grad_mask));
+DenseActivation::DenseActivation(int input_size, int output_size, kernels::Activation kind, float alpha)
+    : DenseActivation(DenseLayer(input_size, output_size), kind, alpha) {}
+
+DenseActivation::DenseActivation(DenseLayer&& dense, kernels::Activation kind, float alpha)
+    : DenseLayer(std::move(dense)), kind(kind), ops(&kernels::activation_kernels(kind)), alpha(alpha)
+{
+    if (!fusable(kind)) {
+        throw std::runtime_error("DenseActivation: activation cannot be fused, its derivative needs the pre-activation.");
     }
+}
 
+double DenseActivation::flops(std::size_t rows, std::size_t input_size, bool backward) const {
+    return DenseLayer::flops(rows, input_size, backward) + static_cast<double>(rows) * weights.rows;
+}
 
-    float ELU::activation_function(float weighted_sum) {
-        return weighted_sum >= 0 ? weighted_sum : alpha * (std::exp(weighted_sum) - 1);
+bool DenseActivation::fusable(kernels::Activation kind) {
+    // Identity is left out: it is what non-elementwise activations such as Softmax report
+    switch (kind) {
+        case kernels::Activation::Sigmoid:
+        case kernels::Activation::Tanh:
+        case kernels::Activation::ReLU:
+        case kernels::Activation::LeakyReLU:
+        case kernels::Activation::ELU:
+            return true;
+        default:
+            return false;
     }
+}
+
+std::unique_ptr<Layer> DenseActivation::replicate() const {
+    return std::make_unique<DenseActivation>(static_cast<int>(weights.cols), static_cast<int>(weights.rows), kind, alpha);
+}
+
+void DenseActivation::forward(const Matrix& inputs, Matrix& outputs) {
+    forward_tiled(inputs, outputs, *ops, alpha);
+}
 
-    xt::xarray<float> ELU::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        auto mask = last_output >= 0;
-        auto derivative = xt::where(mask, 1.0f, alpha * xt::exp(last_output));
-        return upstream_gradient * derivative;
+bool DenseActivation::forward_bf16(const Bf16Matrix& inputs, Matrix& outputs) {
+    forward_tiled_bf16(inputs, outputs, *ops, alpha);
+    return true;
+}
+
+bool DenseActivation::forward_sparse(const CsrMatrix& inputs, Matrix& outputs) {
+    forward_csr(inputs, outputs, *ops, alpha);
+    return true;
+}
+
+void DenseActivation::backward_sparse(const CsrMatrix& inputs, const Matrix& outputs, const Matrix& upstream_gradient) {
+    thread_local std::vector<float> delta;
+    delta.resize(outputs.size());
+    ops->backward(outputs.data(), outputs.data(), upstream_gradient.data(), delta.data(), outputs.size(), alpha);
+    accumulate_csr_gradients(inputs, delta.data());
+}
+
+void DenseActivation::backward(const Matrix& inputs, const Matrix& outputs,
+                               const Matrix& upstream_gradient, Matrix& downstream_gradient) {
+    size_t batch_size = inputs.shape()[0];
+    size_t input_size = weights.cols;
+    size_t output_size = weights.rows;
+    size_t tile = tile_rows(output_size);
+
+    // dy * f'(z) for one tile; per thread so concurrent models never share it
+    thread_local std::vector<float> delta;
+    delta.resize(tile * output_size);
+
+    auto weights_gradient = weights.gradients();
+    for (size_t start = 0; start < batch_size; start += tile) {
+        size_t rows = std::min(tile, batch_size - start);
+        size_t offset = start * output_size;
+
+        // the sign of z and f'(z) of every fusable activation can be read
+        // from y = f(z), so the outputs stand in for the pre-activations
+        const float* y = outputs.data() + offset;
+        ops->backward(y, y, upstream_gradient.data() + offset, delta.data(), rows * output_size, alpha);
+
+        auto delta_tile = row_block(delta.data(), rows, output_size);
+        auto dx_tile = row_block(downstream_gradient.data() + start * input_size, rows, input_size);
+        xt::blas::gemm(delta_tile, weights.values(), dx_tile);
+        xt::blas::gemm(delta_tile, row_block(inputs.data() + start * input_size, rows, input_size),
+                       weights_gradient, true, false, 1.0f, 1.0f);
+        add_column_sums(delta.data(), rows, output_size, biases.gradient);
     }
+}
 
-    float GELU::activation_function(float weighted_sum) {
-        return 0.5 * weighted_sum * (1 + std::tanh(std::sqrt(2 / M_PI) * (weighted_sum + 0.044715 * std::pow(weighted_sum, 3))));
+namespace activation {
+
+    float Sigmoid::activation_function(float weighted_sum) {
+        return 1.0 / (1.0 + std::exp(-weighted_sum));
     }
 
-    xt::xarray<float> GELU::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        const float sqrt_2_over_pi = std::sqrt(2.0f / M_PI);
-        auto tanh_val = xt::tanh(sqrt_2_over_pi * (last_output + 0.044715f * xt::pow(last_output, 3)));
-        auto derivative = 0.5f * (1.0f + tanh_val + last_output * (1 - xt::pow(tanh_val, 2)) * sqrt_2_over_pi * (1.0f + 0.134145f * xt::pow(last_output, 2)));
-        return upstream_gradient * derivative;
+    float Tanh::activation_function(float weighted_sum) {
+        return std::tanh(weighted_sum);
     }
 
+    float ReLU::activation_function(float weighted_sum) {
+        return std::max((float)0.0f, weighted_sum);
+    }
 
-    xt::xarray<float> Softmax::forward(const xt::xarray<float>& inputs) {
-        xt::xarray<float> max_per_row = xt::amax(inputs, {1}, xt::keep_dims);
-        xt::xarray<float> stable_inputs = inputs - max_per_row;
+    float LeakyReLU::activation_function(float weighted_sum) {
+        return weighted_sum >= 0 ? weighted_sum : alpha * weighted_sum;
+    }
 
-        xt::xarray<float> exp_inputs = xt::exp(stable_inputs);
-        xt::xarray<float> sum_exp_per_row = xt::sum(exp_inputs, {1}, xt::keep_dims);
+    float ELU::activation_function(float weighted_sum) {
+        return weighted_sum >= 0 ? weighted_sum : alpha * (std::exp(weighted_sum) - 1);
+    }
 
-        this->inputs = inputs;
-        last_output = exp_inputs / sum_exp_per_row;
-        return last_output;
+    float GELU::activation_function(float weighted_sum) {
+        return 0.5 * weighted_sum * (1 + std::tanh(std::sqrt(2 / M_PI) * (weighted_sum + 0.044715 * std::pow(weighted_sum, 3))));
     }
 
-    xt::xarray<float> Softmax::backward(const xt::xarray<float>& upstream_gradient, float lr) {
-        size_t batch_size = last_output.shape()[0];
-        size_t num_classes = last_output.shape()[1];
 
-        auto y = last_output;
+    void Softmax::forward(const Matrix& inputs, Matrix& outputs) {
+        size_t batch_size = inputs.shape()[0];
+        size_t num_classes = inputs.shape()[1];
 
-        auto y_col = xt::expand_dims(y, 2);
-        auto y_row = xt::expand_dims(y, 1);
-        xt::xarray<float> yyT = y_col * y_row;
+        for (size_t i = 0; i < batch_size; ++i) {
+            const float* in = inputs.data() + i * num_classes;
+            float* out = outputs.data() + i * num_classes;
+
+            float max = *std::max_element(in, in + num_classes);
+            float sum = 0.0f;
+            for (size_t j = 0; j < num_classes; ++j) {
+                out[j] = std::exp(in[j] - max);
+                sum += out[j];
+            }
+            float inv_sum = 1.0f / sum;
+            for (size_t j = 0; j < num_classes; ++j) {
+                out[j] *= inv_sum;
+            }
+        }
+    }
 
-        auto I_batched = xt::eye(num_classes).reshape({1, num_classes, num_classes});
-        auto y_reshaped = y.reshape({batch_size, num_classes, 1});
-        xt::xarray<float> diag_y = xt::eval(y_reshaped * I_batched);
+    void Softmax::backward(const Matrix& inputs, const Matrix& outputs,
+                           const Matrix& upstream_gradient, Matrix& downstream_gradient) {
+        size_t batch_size = outputs.shape()[0];
+        size_t num_classes = outputs.shape()[1];
 
-        xt::xarray<float> J = diag_y - yyT;
-        
-        xt::xarray<float> gradients_to_z = xt::xarray<float>::from_shape({batch_size, num_classes});
+        // J^T g with J = diag(y) - y y^T, without building J: y * (g - <g, y>)
         for (size_t i = 0; i < batch_size; ++i) {
-            auto J_sample = xt::view(J, i, xt::all(), xt::all());
-            auto up_grad_sample = xt::view(upstream_gradient, i, xt::all());
-            xt::view(gradients_to_z, i, xt::all()) = xt::linalg::dot(J_sample, up_grad_sample);
+            const float* y = outputs.data() + i * num_classes;
+            const float* g = upstream_gradient.data() + i * num_classes;
+            float* dz = downstream_gradient.data() + i * num_classes;
+
+            float dot = 0.0f;
+            for (size_t j = 0; j < num_classes; ++j) {
+                dot += g[j] * y[j];
+            }
+            for (size_t j = 0; j < num_classes; ++j) {
+                dz[j] = y[j] * (g[j] - dot);
+            }
         }
-        
-        return gradients_to_z;
     }
 
 }
\ No newline at end of file
@@ -3,39 +3,81 @@
 
 namespace loss {
 
-    float MSE::forward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) {
+    float MSE::forward(const Matrix& predicted, const Matrix& truth) {
         auto diff = predicted - truth;
         float sum_of_squares = xt::sum(xt::square(diff))();
         size_t batch_size = predicted.shape()[0];
         return sum_of_squares / (2 * batch_size);
     }
 
-    xt::xarray<float> MSE::backward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) {
-        return predicted - truth;
+    void MSE::backward(const Matrix& predicted, const Matrix& truth, Matrix& gradient) {
+        xt::noalias(gradient) = predicted - truth;
     }
 
-    float CrossEntropy::forward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) {
+    float CrossEntropy::forward(const Matrix& predicted, const Matrix& truth) {
         // numerical stability: clip predicted values to avoid log(0) = -inf
         const float epsilon = 1e-15;
-        xt::xarray<float> clamped_predicted = xt::clip(predicted, epsilon, 1.0f - epsilon);
-        auto log_predicted = xt::log(clamped_predicted);
-        auto sum = xt::sum(truth * log_predicted)();
-        return -sum;
+        size_t batch_size = predicted.shape()[0];
+
+        float sum = 0.0f;
+        for (size_t i = 0; i < batch_size; ++i) {
+            float p = predicted(i, static_cast<size_t>(truth(i, 0)));
+            sum += std::log(std::clamp(p, epsilon, 1.0f - epsilon));
+        }
+        return -sum / batch_size;
     }
 
-    xt::xarray<float> CrossEntropy::backward(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) {
-        return -truth / predicted;
+    void CrossEntropy::backward(const Matrix& predicted, const Matrix& truth, Matrix& gradient) {
+        gradient.fill(0.0f);
+        for (size_t i = 0; i < predicted.shape()[0]; ++i) {
+            size_t label = static_cast<size_t>(truth(i, 0));
+            gradient(i, label) = -1.0f / predicted(i, label);
+        }
     }
 
-    xt::xarray<float> CrossEntropy::backward_fused(const xt::xarray<float>& predicted, const xt::xarray<float>& truth) {
-        xt::xarray<float> grad = predicted;
+    float CrossEntropy::forward_backward_logits(const Matrix& logits, const Matrix& truth, Matrix& gradient) {
+        size_t batch_size = logits.shape()[0];
+        size_t num_classes = logits.shape()[1];
+
+        float sum = 0.0f;
+        for (size_t i = 0; i < batch_size; ++i) {
+            const float* z = logits.data() + i * num_classes;
+            float* grad = gradient.data() + i * num_classes;
+            size_t label = static_cast<size_t>(truth(i, 0));
 
-        xt::xarray<size_t> batch_indices = xt::arange(predicted.shape(0));
-        for (size_t i = 0; i < batch_indices.size(); ++i) {
-            grad(batch_indices(i), truth(i)) -= 1.0f;
+            float max = *std::max_element(z, z + num_classes);
+            float sum_exp = 0.0f;
+            for (size_t j = 0; j < num_classes; ++j) {
+                grad[j] = std::exp(z[j] - max);
+                sum_exp += grad[j];
+            }
+
+            // -log softmax(z)[label] = log-sum-exp(z) - z[label]
+            sum += max + std::log(sum_exp) - z[label];
+
+            float inv_sum = 1.0f / sum_exp;
+            for (size_t j = 0; j < num_classes; ++j) {
+                grad[j] *= inv_sum;
+            }
+            grad[label] -= 1.0f;
         }
+        return sum / batch_size;
+    }
 
+    float CrossEntropy::forward_logits(const Matrix& logits, const Matrix& truth) {
+        size_t batch_size = logits.shape()[0];
+        size_t num_classes = logits.shape()[1];
 
-        return grad;
+        float sum = 0.0f;
+        for (size_t i = 0; i < batch_size; ++i) {
+            const float* z = logits.data() + i * num_classes;
+            float max = *std::max_element(z, z + num_classes);
+            float sum_exp = 0.0f;
+            for (size_t j = 0; j < num_classes; ++j) {
+                sum_exp += std::exp(z[j] - max);
+            }
+            sum += max + std::log(sum_exp) - z[static_cast<size_t>(truth(i, 0))];
+        }
+        return sum / batch_size;
     }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <functional>
 
 #include "model.hpp"
+#include "utils/data_config.hpp"
 
 
 
@@ -14,7 +15,11 @@ void test_callback(const EpochResult& result) {
 			  << ", train_loss: " << result.train_loss 
 			  << ", val_loss: " << result.val_loss
 			  << ", val_accuracy: " << result.val_accuracy
+			  << ", data_stall_s: " << result.data_stall_s
 			  << std::endl;
+	if (!result.trace.empty()) {
+		result.trace.print(std::cout);
+	}
 }
 
 int main() {
@@ -24,29 +29,13 @@ int main() {
 		return 1;
 	}
 
-	IrisDataset dataset(
-		"../data/Iris/iris.data"
-	);
-
 	auto start = std::chrono::high_resolution_clock::now();
 	xt::random::seed(time(NULL));
 
 
-	float validation_split = config.value("validation_split", 0.2);
-
-	// Split the dataset into training and validation sets
-	auto splits = dataset.split_dataset(validation_split, 0.1f);
-
-	auto train_dataloader = Dataloader(
-		std::move(splits.train),
-		config.value("train_batch_size", 4),
-		true
-	);
-
-	auto val_dataloader = Dataloader(
-		std::move(splits.val),
-		config.value("val_batch_size", 4)
-	);
+	auto splits = load_data_splits(config);
+	auto& train_dataloader = splits.train;
+	auto& val_dataloader = splits.val;
 
 	float lr = config.value("learning_rate", 1e-4);
 	float weight_decay = config.value("weight_decay", 1e-4);
@@ -55,12 +44,47 @@ int main() {
 
 	auto loss = std::make_unique<loss::CrossEntropy>();
 	Model model(std::move(loss), lr, weight_decay, epochs, test_callback);
-	model.addLayer(std::make_unique<DenseLayer>(4, 16));
-	model.addLayer(std::make_unique<activation::ReLU>());
-	model.addLayer(std::make_unique<DenseLayer>(16, 3));
+	model.setOptimizer(optim::make_optimizer(config));
+	model.setThreads(config.value("threads", 1));
+	model.setPrefetch(config.value("prefetch_batches", 0));
+	model.setGradAccumulation(config.value("grad_accumulation_steps", 1));
+	model.setTracing(config.value("trace", false), config.value("trace_path", ""));
+	model.setMixedPrecision(config.value("mixed_precision", false));
+	model.setNoGradInference(config.value("no_grad_inference", true));
+	model.setRecomputeSegment(config.value("recompute_segment", 1));
+	model.setActivationBudget(static_cast<std::size_t>(config.value("activation_budget_mb", 0.0) * 1e6));
+	if (config.value("model", "mlp") == "cnn") {
+		if (splits.image_shape.size() == 0) {
+			std::cerr << "The cnn model needs an image dataset" << std::endl;
+			return 1;
+		}
+		auto conv1 = std::make_unique<Conv2DLayer>(splits.image_shape, 8, 3);
+		auto pool1 = std::make_unique<MaxPool2D>(conv1->output_image(), 2);
+		auto conv2 = std::make_unique<Conv2DLayer>(pool1->output_image(), 16, 3);
+		auto pool2 = std::make_unique<MaxPool2D>(conv2->output_image(), 2);
+		ImageShape features = pool2->output_image();
+		model.addLayer(std::move(conv1));
+		model.addLayer(std::make_unique<activation::ReLU>());
+		model.addLayer(std::move(pool1));
+		model.addLayer(std::move(conv2));
+		model.addLayer(std::make_unique<activation::ReLU>());
+		model.addLayer(std::move(pool2));
+		model.addLayer(std::make_unique<Flatten>(features));
+		model.addLayer(std::make_unique<DenseLayer>(features.size(), splits.n_classes));
+	} else {
+		model.addLayer(std::make_unique<DenseLayer>(train_dataloader->n_features, 16));
+		model.addLayer(std::make_unique<activation::ReLU>());
+		model.addLayer(std::make_unique<DenseLayer>(16, splits.n_classes));
+	}
 	model.addLayer(std::make_unique<activation::Softmax>());
 
-	model.train(train_dataloader, val_dataloader);
+	std::string checkpoint_path = config.value("checkpoint_path", "");
+	model.setCheckpoint(checkpoint_path, config.value("checkpoint_every", 1));
+	if (config.value("resume", false) && !checkpoint_path.empty()) {
+		model.loadCheckpoint(checkpoint_path);
+	}
+
+	model.train(*train_dataloader, *val_dataloader);
 
 	auto end = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<float> duration = end - start;
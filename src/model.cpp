@@ -1,13 +1,120 @@
 #include "model.hpp"
+#include <cxxabi.h>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <set>
+
+
+namespace {
+    // "activation::ReLU" -> "ReLU"
+    std::string layer_name(const Layer& layer) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(typeid(layer).name(), nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : typeid(layer).name();
+        std::free(demangled);
+        return name.substr(name.rfind(':') == std::string::npos ? 0 : name.rfind(':') + 1);
+    }
+
+    // Bytes read and written by a layer pass: its activations, and its
+    // parameters (plus their gradients backward).
+    double layer_bytes(const Matrix& inputs, const Matrix& outputs, std::size_t parameters, bool backward) {
+        double activations = static_cast<double>(inputs.size() + outputs.size());
+        return sizeof(float) * (backward ? 2.0 * activations + 2.0 * parameters : activations + parameters);
+    }
+
+    // Runs the first layer on CSR rows or, for layers without a sparse path,
+    // on the rows densified into activations[0]. True if the sparse path ran.
+    bool forward_sparse_inputs(Layer& layer, const CsrMatrix& inputs, Workspace& workspace, Matrix& outputs) {
+        if (layer.forward_sparse(inputs, outputs)) {
+            return true;
+        }
+        workspace.activations[0].resize({inputs.rows, inputs.cols});
+        if (!workspace.gradient_buffers.empty()) {
+            workspace.gradient_buffers[0]->resize({inputs.rows, inputs.cols});
+        }
+        inputs.to_dense(workspace.activations[0].data());
+        layer.forward(workspace.activations[0], outputs);
+        return false;
+    }
+
+    // Bytes of the training workspace reserve() lays out for `rows` rows and
+    // segments of `segment` layers, the input batch included.
+    std::size_t training_bytes(const std::vector<std::size_t>& widths, std::size_t rows, std::size_t segment) {
+        std::size_t floats = 0;
+        if (segment == 1) {
+            for (std::size_t width : widths) {
+                floats += 2 * width;
+            }
+            return floats * rows * sizeof(float);
+        }
+        std::set<std::pair<std::size_t, std::size_t>> inside;
+        std::set<std::size_t> gradient_widths;
+        for (std::size_t i = 0; i < widths.size(); i++) {
+            if (i % segment == 0) {
+                floats += widths[i];
+            } else {
+                inside.insert({i % segment, widths[i]});
+            }
+            gradient_widths.insert(widths[i]);
+        }
+        for (const auto& [position, width] : inside) {
+            floats += width;
+        }
+        for (std::size_t width : gradient_widths) {
+            floats += 2 * width;
+        }
+        return floats * rows * sizeof(float);
+    }
+}
 
 
 void Model::train(Dataloader& train_dataloader, Dataloader& val_dataloader) {
     float train_err = 0.0f;
     float val_err = 0.0f;
 
-    float dynamic_lr = lr;
+    // a resumed run continues where its checkpoint left off
+    float dynamic_lr = resume_lr > 0.0f ? resume_lr : lr;
+    int first_epoch = start_epoch;
+    start_epoch = 0;
+    resume_lr = 0.0f;
+    stop_requested = false;
+
+    if (!parameters_bound) {
+        bind_parameters();
+    }
+    if (mixed_precision && train_dataloader.sparse()) {
+        throw std::runtime_error("Model: mixed precision does not support sparse inputs.");
+    }
+    if (mixed_precision && (recompute_segment > 1 || activation_budget > 0)) {
+        throw std::runtime_error("Model: mixed precision does not support activation recompute.");
+    }
+    if (train_dataloader.batch_size % accumulation_steps != 0) {
+        throw std::runtime_error("Model: the batch size (" + std::to_string(train_dataloader.batch_size)
+                                 + ") must be a multiple of the accumulation steps (" + std::to_string(accumulation_steps) + ").");
+    }
+    // workers and their workspaces only ever see a micro-batch
+    setup_workers(train_dataloader.batch_size / accumulation_steps, train_dataloader.n_features, train_dataloader.sparse());
+    if (tracing_compiled && tracer.enabled) {
+        configure_tracer();
+    }
 
-    for (int epoch = 0; epoch < epochs; epoch++) {
+    prefetcher.reset();
+    if (prefetch_depth > 0) {
+        // micro-batch after micro-batch, one shard per worker in each
+        std::vector<std::size_t> shard_sizes;
+        for (std::size_t micro = 0; micro < accumulation_steps; micro++) {
+            for (auto& worker : workers) {
+                shard_sizes.push_back(worker.shard_size);
+            }
+        }
+        prefetcher = std::make_unique<Prefetcher>(train_dataloader, shard_sizes, prefetch_depth, first_epoch);
+        if (!prefetcher->pinned()) {
+            std::cerr << "Prefetcher: could not lock batch buffers in memory (RLIMIT_MEMLOCK), continuing unpinned" << std::endl;
+        }
+    }
+
+    for (int epoch = first_epoch; epoch < epochs; epoch++) {
         train_err = 0.0f;
         val_err = 0.0f;
         
@@ -16,83 +123,714 @@ void Model::train(Dataloader& train_dataloader, Dataloader& val_dataloader) {
         auto start_time = std::chrono::high_resolution_clock::now();
         
         ProgressBar progress_bar(epochs, total_batches);
-        for (auto [inputs, truths] : train_dataloader) {
-            
-            auto batch_err = train_step(inputs, truths, dynamic_lr);
+        if (!prefetcher) {
+            train_dataloader.epoch_indices(epoch, epoch_order);
+        }
+        for (unsigned int batch = 0; batch < train_dataloader.n_batches; batch++) {
+            Tracer::Lane* lane = trace_lane(0);
+            int64_t wait_start = lane && prefetcher ? Tracer::now_ns() : 0;
+            const Prefetcher::Slot* slot = prefetcher ? &prefetcher->acquire() : nullptr;
+            if (lane && prefetcher) {
+                lane->record(0, Tracer::Phase::Data, wait_start, Tracer::now_ns());
+            }
+            const std::size_t* batch_indices = slot ? nullptr : epoch_order.data() + static_cast<std::size_t>(batch) * train_dataloader.batch_size;
+            auto batch_err = train_step(train_dataloader, batch_indices, slot, dynamic_lr);
+            if (prefetcher) {
+                prefetcher->release();
+            }
             train_err += batch_err;
 
             auto current_time = std::chrono::high_resolution_clock::now();
             auto elapsed_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time);
             double elapsed_time_s = static_cast<double>(elapsed_time_ms.count()) / 1000.0;
-            progress_bar.update(epoch, batch_err, elapsed_time_s);
+            if (show_progress) {
+                progress_bar.update(epoch, batch_err, elapsed_time_s);
+            }
+        }
+        if (show_progress) {
+            progress_bar.clear();
         }
-        progress_bar.clear();
 
         dynamic_lr = lr * std::exp(-weight_decay * epoch);
         train_err /= (float) total_batches;
         
-        unsigned int correct_predictions = 0;
-        float val_err = 0.0f;
-        for (auto [inputs, truths] : val_dataloader) {
-            auto [batch_val_err, correct_prediction] = validation_step(inputs, truths);
-            val_err += batch_val_err;
-            correct_predictions += correct_prediction;
-        }
+        auto [val_err, val_accuracy] = evaluate(val_dataloader);
 
-        val_err /= (float) val_dataloader.n_batches;
-        float val_accuracy = (float) correct_predictions / (float) val_dataloader.total_samples;
+        Prefetcher::Stats data_stats = prefetcher ? prefetcher->take_stats() : Prefetcher::Stats();
 
         auto result = EpochResult{
             .epoch = epoch,
             .train_loss = train_err,
             .val_loss = val_err,
             .val_accuracy = val_accuracy,
+            .data_stall_s = static_cast<float>(data_stats.stall_s),
+            .data_backpressure_s = static_cast<float>(data_stats.backpressure_s),
+            .trace = tracing_compiled && tracer.enabled ? tracer.take_summary() : TraceSummary(),
         };
 
         if (on_epoch_end_callback) {
             on_epoch_end_callback(result);
         }
+
+        // after the callback, so an epoch ended by stopTraining() is saved too;
+        // only a memcpy here, the file is written in the background
+        bool stopping = stop_requested;
+        if (checkpoint_writer && ((epoch + 1) % checkpoint_every == 0 || epoch + 1 == epochs || stopping)) {
+            save_checkpoint(epoch, dynamic_lr);
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    // stop the producer thread, it would otherwise idle on a full ring
+    prefetcher.reset();
+    if (checkpoint_writer) {
+        checkpoint_writer->flush();
+    }
+    if (tracing_compiled && tracer.enabled && !trace_path.empty()) {
+        tracer.write_chrome_trace(trace_path);
     }
 }
 
-float Model::train_step(xt::xarray<float>& inputs, xt::xarray<float>& truths, float dynamic_lr) {
-    auto curr = inputs;
+std::tuple<float, float> Model::evaluate(const Dataloader& dataloader) {
+    bool sparse = dataloader.sparse();
+    reserve(val_workspace, dataloader.batch_size, dataloader.n_features,
+            no_grad_inference ? WorkspaceKind::Inference : WorkspaceKind::Training, sparse);
+
+    unsigned int correct_predictions = 0;
+    float loss_sum = 0.0f;
+    for (unsigned int batch = 0; batch < dataloader.n_batches; batch++) {
+        if (sparse) {
+            dataloader.load_rows_sparse(static_cast<std::size_t>(batch) * dataloader.batch_size, dataloader.batch_size,
+                                        val_workspace.sparse_inputs, val_workspace.truths);
+        } else {
+            dataloader.load_batch(batch, val_workspace.activations.front(), val_workspace.truths);
+        }
+
+        auto [batch_err, correct_prediction] = validation_step(val_workspace, sparse);
+        loss_sum += batch_err;
+        correct_predictions += correct_prediction;
+    }
+    return {loss_sum / (float) dataloader.n_batches, (float) correct_predictions / (float) dataloader.total_samples};
+}
+
+QuantizationReport Model::quantize(const Dataloader& calibration, unsigned int max_batches) {
+    QuantizationReport report;
+    auto is_dense = [](const Layer& layer) {
+        return typeid(layer) == typeid(DenseLayer) || typeid(layer) == typeid(DenseActivation);
+    };
+
+    // observe the input range of every dense layer on a sample of the data
+    std::vector<ActivationRange> ranges(layers.size());
+    Workspace workspace;
+    reserve(workspace, calibration.batch_size, calibration.n_features, WorkspaceKind::Training);
+    std::vector<std::size_t> order;
+    calibration.epoch_indices(0, order);
+    unsigned int n_batches = std::min(max_batches, calibration.n_batches);
+    for (unsigned int batch = 0; batch < n_batches; batch++) {
+        calibration.gather(order.data() + static_cast<std::size_t>(batch) * calibration.batch_size,
+                           calibration.batch_size, workspace.activations.front(), workspace.truths);
+        for (std::size_t i = 0; i < layers.size(); i++) {
+            if (is_dense(*layers[i])) {
+                ranges[i].observe(workspace.activations[i].data(), workspace.activations[i].size());
+            }
+            layers[i]->forward(workspace.activations[i], workspace.activations[i + 1]);
+        }
+    }
+
+    // runs of consecutive dense layers become one QuantizedDenseLayer
+    std::vector<std::unique_ptr<Layer>> quantized_layers;
+    QuantizedDenseLayer* current = nullptr;
+    for (std::size_t i = 0; i < layers.size(); i++) {
+        if (!is_dense(*layers[i])) {
+            quantized_layers.push_back(std::move(layers[i]));
+            current = nullptr;
+            continue;
+        }
+        if (!current) {
+            auto block = std::make_unique<QuantizedDenseLayer>();
+            current = block.get();
+            quantized_layers.push_back(std::move(block));
+        }
+
+        auto dense = static_cast<DenseLayer*>(layers[i].get());
+        auto fused = dynamic_cast<DenseActivation*>(dense);
+        current->add_stage(*dense, fused ? fused->activation() : kernels::Activation::Identity,
+                           fused ? fused->parameter() : 0.0f, ranges[i]);
+        report.float_weight_bytes += (dense->weights.size() + dense->biases.size()) * sizeof(float);
+    }
+    for (auto& layer : quantized_layers) {
+        if (auto block = dynamic_cast<QuantizedDenseLayer*>(layer.get())) {
+            report.int8_weight_bytes += block->weight_bytes();
+        }
+    }
+
+    layers = std::move(quantized_layers);
+    parameters_bound = false;
+    workers.clear();
+    return report;
+}
+
+void Model::setBatching(std::size_t max_batch_size, std::chrono::microseconds max_delay) {
+    std::lock_guard<std::mutex> lock(predictor_mutex);
+    predict_max_batch_size = max_batch_size;
+    predict_max_delay = max_delay;
+    // drains the queued requests, the next predict starts a dispatcher with the new limits
+    predictor.reset();
+}
+
+std::future<std::vector<float>> Model::predict(std::vector<float> features) {
+    // submitting only enqueues, so holding the lock costs callers nothing measurable
+    std::lock_guard<std::mutex> lock(predictor_mutex);
+    if (!predictor) {
+        predictor = std::make_unique<Predictor>(
+            [this](Workspace& workspace, std::size_t rows, std::size_t input_size) {
+                reserve(workspace, rows, input_size,
+                        no_grad_inference ? WorkspaceKind::Inference : WorkspaceKind::Training);
+            },
+            [this](Workspace& workspace) -> const Matrix& { return forward(workspace); },
+            predict_max_batch_size, predict_max_delay);
+    }
+    return predictor->submit(std::move(features));
+}
+
+PredictionStats Model::predictionStats() {
+    std::lock_guard<std::mutex> lock(predictor_mutex);
+    return predictor ? predictor->stats() : PredictionStats();
+}
+
+std::vector<Parameter*> Model::all_parameters() {
+    std::vector<Parameter*> result;
     for (auto& layer : layers) {
-        curr = layer->forward(curr);
+        for (auto parameter : layer->parameters()) {
+            result.push_back(parameter);
+        }
+    }
+    return result;
+}
+
+std::size_t Model::parameterCount() {
+    std::size_t count = 0;
+    for (auto parameter : all_parameters()) {
+        count += parameter->size();
+    }
+    return count;
+}
+
+void Model::bind_parameters() {
+    parameters.bind(all_parameters());
+    parameters_bound = true;
+}
+
+void Model::setTracing(bool enabled, const std::string& path) {
+    if (enabled && !tracing_compiled) {
+        std::cerr << "Model: tracing was compiled out (NN_TRACING=0), ignoring setTracing" << std::endl;
+    }
+    tracer.enabled = enabled && tracing_compiled;
+    trace_path = path;
+}
+
+void Model::configure_tracer() {
+    std::vector<std::string> names;
+    std::vector<std::size_t> parameter_counts;
+    for (std::size_t i = 0; i < layers.size(); i++) {
+        names.push_back(std::to_string(i) + " " + layer_name(*layers[i]));
+        std::size_t count = 0;
+        for (auto parameter : layers[i]->parameters()) {
+            count += parameter->size();
+        }
+        parameter_counts.push_back(count);
+    }
+    tracer.configure(std::move(names), std::move(parameter_counts), workers.size());
+}
+
+void Model::setCheckpoint(const std::string& path, int every_epochs) {
+    if (every_epochs < 1) {
+        throw std::runtime_error("Model: checkpoints must be saved every >= 1 epochs.");
+    }
+    checkpoint_writer.reset();
+    if (!path.empty()) {
+        checkpoint_writer = std::make_unique<checkpoint::AsyncWriter>(path);
+    }
+    checkpoint_every = every_epochs;
+}
+
+void Model::loadCheckpoint(const std::string& path) {
+    checkpoint::Reader reader(path);
+    auto records = reader.layers();
+
+    if (layers.empty()) {
+        for (auto& record : records) {
+            addLayer(checkpoint::make_layer(record));
+        }
+    }
+    if (layers.size() != records.size()) {
+        throw std::runtime_error("Model: " + path + " holds " + std::to_string(records.size())
+                                 + " layers, the model has " + std::to_string(layers.size()));
+    }
+    for (std::size_t i = 0; i < layers.size(); i++) {
+        if (!checkpoint::same_layer(checkpoint::describe(*layers[i]), records[i])) {
+            throw std::runtime_error("Model: layer " + std::to_string(i) + " does not match " + path);
+        }
+    }
+
+    const auto& header = reader.header();
+    parameters.bind_external(all_parameters(), reader.parameters(), header.parameter_count, reader.mapping());
+    parameters_bound = true;
+
+    auto state = optimizer->state(parameters.size());
+    if (state.size() == header.optimizer_buffers) {
+        for (std::size_t i = 0; i < state.size(); i++) {
+            std::copy_n(reader.optimizer_buffer(i), parameters.size(), state[i]);
+        }
+        optimizer->set_steps(header.optimizer_steps);
+    } else {
+        std::cerr << "Model: the optimizer state in " << path << " does not match the optimizer, starting it afresh" << std::endl;
+    }
+
+    start_epoch = header.epoch + 1;
+    resume_lr = header.dynamic_lr;
+}
+
+void Model::save_checkpoint(int epoch, float dynamic_lr) {
+    checkpoint::State state{
+        .parameters = parameters.values(),
+        .parameter_count = parameters.size(),
+        .optimizer = optimizer->state(parameters.size()),
+        .optimizer_steps = optimizer->steps(),
+        .epoch = epoch,
+        .dynamic_lr = dynamic_lr,
+    };
+    checkpoint::serialize(layers, state, checkpoint_buffer);
+    checkpoint_writer->submit(checkpoint_buffer);
+}
+
+void Model::reserve(Workspace& workspace, std::size_t batch_size, std::size_t input_size, WorkspaceKind kind,
+                    bool sparse, std::size_t segment) {
+    std::vector<std::size_t> widths{input_size};
+    for (auto& layer : layers) {
+        widths.push_back(layer->output_size(widths.back()));
+    }
+    workspace.truths.resize({batch_size, 1});
+    workspace.activation_buffers.resize(layers.size() + 1);
+    workspace.segment = kind == WorkspaceKind::Recompute ? segment : 1;
+    workspace.segment_buffers.clear();
+
+    if (kind == WorkspaceKind::Recompute) {
+        if (sparse) {
+            widths[0] = 0;
+        }
+        workspace.activations.resize(layers.size() / segment + 1);
+        workspace.gradients.clear();
+        workspace.stored.clear();
+        workspace.shared_buffers.clear();
+        workspace.gradient_buffers.resize(layers.size() + 1);
+        for (std::size_t i = 0; i <= layers.size(); i++) {
+            Matrix& activation = i % segment == 0 ? workspace.activations[i / segment]
+                                                  : workspace.segment_buffers[{i % segment, widths[i]}];
+            activation.resize({batch_size, widths[i]});
+            workspace.activation_buffers[i] = &activation;
+            Matrix& gradient = workspace.shared_buffers[widths[i]][2 + i % 2];
+            gradient.resize({batch_size, widths[i]});
+            workspace.gradient_buffers[i] = &gradient;
+        }
+        return;
+    }
+
+    if (kind == WorkspaceKind::Training) {
+        workspace.activations.resize(layers.size() + 1);
+        workspace.gradients.resize(layers.size() + 1);
+        workspace.gradient_buffers.resize(layers.size() + 1);
+        for (std::size_t i = 0; i <= layers.size(); i++) {
+            std::size_t width = i == 0 && sparse ? 0 : widths[i];
+            workspace.activations[i].resize({batch_size, width});
+            workspace.gradients[i].resize({batch_size, width});
+            workspace.activation_buffers[i] = &workspace.activations[i];
+            workspace.gradient_buffers[i] = &workspace.gradients[i];
+        }
+        workspace.stored.clear();
+        workspace.shared_buffers.clear();
+        return;
+    }
+
+    workspace.activations.resize(1);
+    workspace.activations[0].resize({batch_size, sparse ? 0 : input_size});
+    workspace.activation_buffers[0] = &workspace.activations[0];
+    workspace.gradients.clear();
+    // buffers of the widths still in use keep their memory from one call to the next;
+    // inference never needs one of the input width
+    auto first_shared = widths.begin() + (kind == WorkspaceKind::Inference ? 1 : 0);
+    std::erase_if(workspace.shared_buffers, [&](const auto& entry) {
+        return std::find(first_shared, widths.end(), entry.first) == widths.end();
+    });
+
+    if (kind == WorkspaceKind::Inference) {
+        workspace.gradient_buffers.clear();
+        workspace.stored.clear();
+        for (std::size_t i = 1; i <= layers.size(); i++) {
+            Matrix* previous = workspace.activation_buffers[i - 1];
+            if (i >= 2 && widths[i] == widths[i - 1] && layers[i - 1]->in_place()) {
+                workspace.activation_buffers[i] = previous;
+                continue;
+            }
+            // only the input of layer i - 1 must survive its forward
+            auto& buffers = workspace.shared_buffers[widths[i]];
+            Matrix* next = previous == &buffers[0] ? &buffers[1] : &buffers[0];
+            next->resize({batch_size, widths[i]});
+            workspace.activation_buffers[i] = next;
+        }
+        return;
+    }
+
+    workspace.stored.resize(layers.size());
+    for (std::size_t i = 0; i < layers.size(); i++) {
+        workspace.stored[i].resize({batch_size, kernels::bf16_padded(widths[i])});
+    }
+    workspace.gradient_buffers.resize(layers.size() + 1);
+    for (std::size_t i = 0; i <= layers.size(); i++) {
+        auto& buffers = workspace.shared_buffers[widths[i]];
+        for (auto& buffer : buffers) {
+            buffer.resize({batch_size, widths[i]});
+        }
+        workspace.activation_buffers[i] = i == 0 ? &workspace.activations[0] : &buffers[i % 2];
+        workspace.gradient_buffers[i] = &buffers[2 + i % 2];
+    }
+}
+
+std::size_t Model::recompute_segment_for(std::size_t batch_size, std::size_t input_size, bool sparse) {
+    if (activation_budget == 0) {
+        return std::max<std::size_t>(1, std::min(recompute_segment, layers.size()));
+    }
+    std::vector<std::size_t> widths{input_size};
+    for (auto& layer : layers) {
+        widths.push_back(layer->output_size(widths.back()));
+    }
+    if (sparse) {
+        widths[0] = 0;
+    }
+
+    // the shortest segment that fits recomputes the least
+    std::size_t n_workers = std::min<std::size_t>(n_threads, batch_size);
+    std::size_t best = 1;
+    std::size_t best_bytes = std::numeric_limits<std::size_t>::max();
+    for (std::size_t segment = 1; segment <= std::max<std::size_t>(1, layers.size()); segment++) {
+        std::size_t bytes = 0;
+        for (std::size_t w = 0; w < n_workers; w++) {
+            bytes += training_bytes(widths, batch_size / n_workers + (w < batch_size % n_workers), segment);
+        }
+        if (bytes <= activation_budget) {
+            return segment;
+        }
+        if (bytes < best_bytes) {
+            best = segment;
+            best_bytes = bytes;
+        }
+    }
+    std::cerr << "Model: no recompute segment fits the activation budget of " << activation_budget
+              << " bytes, using " << best << " layers (" << best_bytes << " bytes)" << std::endl;
+    return best;
+}
+
+std::size_t Model::workspaceBytes() const {
+    std::size_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker.workspace.bytes();
+    }
+    return total;
+}
+
+void Model::setup_workers(std::size_t batch_size, std::size_t input_size, bool sparse) {
+    // shards never go empty, and stay the same size from batch to batch so no buffer is reallocated
+    std::size_t n_workers = std::min<std::size_t>(n_threads, batch_size);
+    workers.clear();
+    workers.resize(n_workers);
+    std::size_t segment = mixed_precision ? 1 : recompute_segment_for(batch_size, input_size, sparse);
+    WorkspaceKind kind = mixed_precision ? WorkspaceKind::MixedPrecision
+                       : segment > 1     ? WorkspaceKind::Recompute
+                                         : WorkspaceKind::Training;
+
+    std::size_t offset = 0;
+    for (std::size_t w = 0; w < n_workers; w++) {
+        Worker& worker = workers[w];
+        worker.shard_offset = offset;
+        worker.shard_size = batch_size / n_workers + (w < batch_size % n_workers);
+        offset += worker.shard_size;
+
+        std::vector<Parameter*> replica_parameters;
+        for (auto& layer : layers) {
+            auto replica = w == 0 ? nullptr : layer->replicate();
+            if (replica) {
+                for (auto parameter : replica->parameters()) {
+                    replica_parameters.push_back(parameter);
+                }
+                worker.layers.push_back(replica.get());
+                worker.replicas.push_back(std::move(replica));
+            } else {
+                worker.layers.push_back(layer.get());
+            }
+        }
+        if (w > 0) {
+            worker.gradients.bind_shared(replica_parameters, parameters);
+        }
+        reserve(worker.workspace, worker.shard_size, input_size, kind, sparse, segment);
+    }
+
+    if (!pool || pool->size() != n_workers) {
+        pool.reset();
+        pool = std::make_unique<WorkerPool>(n_workers);
+    }
+}
+
+void Model::reduce_gradients() {
+    // pairwise tree: log2(workers) rounds, the pairs of a round summed in parallel
+    std::size_t n_workers = workers.size();
+    for (std::size_t stride = 1; stride < n_workers; stride *= 2) {
+        pool->run([&](std::size_t w) {
+            if (w % (2 * stride) != 0 || w + stride >= n_workers) {
+                return;
+            }
+            ParameterArena& target = worker_arena(w);
+            float* __restrict dst = std::assume_aligned<arena_alignment>(target.gradients());
+            const float* __restrict src = std::assume_aligned<arena_alignment>(worker_arena(w + stride).gradients());
+            for (std::size_t i = 0; i < target.size(); i++) {
+                dst[i] += src[i];
+            }
+        });
+    }
+}
+
+float Model::train_step(const Dataloader& dataloader, const std::size_t* batch_indices, const Prefetcher::Slot* slot, float dynamic_lr) {
+    bool sparse = dataloader.sparse();
+    std::size_t micro_batch = dataloader.batch_size / accumulation_steps;
+    for (auto& worker : workers) {
+        worker.loss = 0.0f;
+    }
+
+    // gradients are zeroed once and summed over the micro-batches
+    for (std::size_t micro = 0; micro < accumulation_steps; micro++) {
+        pool->run([&](std::size_t w) {
+            Worker& worker = workers[w];
+            Workspace& workspace = worker.workspace;
+            Tracer::Lane* lane = trace_lane(w);
+            auto run = [&](const Matrix& inputs, const CsrMatrix& sparse_inputs, const Matrix& truths) {
+                return mixed_precision ? forward_backward_mixed(worker.layers, inputs, truths, workspace, lane)
+                                       : forward_backward(worker.layers, inputs, sparse ? &sparse_inputs : nullptr,
+                                                          truths, workspace, lane);
+            };
+            if (micro == 0) {
+                worker_arena(w).zero_gradients();
+            }
+            // shard losses are means, weighted back into a sum
+            if (slot) {
+                // prefetched shards are read in place
+                const Prefetcher::Shard& shard = slot->shards[micro * workers.size() + w];
+                worker.loss += run(shard.x, shard.x_sparse, shard.y) * worker.shard_size;
+            } else {
+                int64_t start = lane ? Tracer::now_ns() : 0;
+                const std::size_t* indices = batch_indices + micro * micro_batch + worker.shard_offset;
+                if (sparse) {
+                    dataloader.gather_sparse(indices, worker.shard_size, workspace.sparse_inputs, workspace.truths);
+                } else {
+                    dataloader.gather(indices, worker.shard_size, workspace.activations.front(), workspace.truths);
+                }
+                if (lane) {
+                    double input_bytes = sparse ? (sizeof(float) + sizeof(uint32_t)) * workspace.sparse_inputs.nnz()
+                                                : sizeof(float) * workspace.activations.front().size();
+                    lane->record(0, Tracer::Phase::Data, start, Tracer::now_ns(), 0.0,
+                                 2.0 * (input_bytes + sizeof(float) * workspace.truths.size()));
+                }
+                worker.loss += run(workspace.activations.front(), workspace.sparse_inputs, workspace.truths) * worker.shard_size;
+            }
+        });
+    }
+
+    Tracer::Lane* lane = trace_lane(0);
+    int64_t start = lane ? Tracer::now_ns() : 0;
+    reduce_gradients();
+    int64_t reduced = lane ? Tracer::now_ns() : 0;
+    optimizer->step(parameters, dynamic_lr, 1.0f / dataloader.batch_size);
+    if (lane) {
+        double arena_bytes = sizeof(float) * static_cast<double>(parameters.size());
+        if (workers.size() > 1) {
+            lane->record(0, Tracer::Phase::Reduce, start, reduced, parameters.size() * (workers.size() - 1.0),
+                         arena_bytes * workers.size());
+        }
+        lane->record(0, Tracer::Phase::Optimizer, reduced, Tracer::now_ns(), 0.0, 3.0 * arena_bytes);
+    }
+
+    float batch_err = 0.0f;
+    for (auto& worker : workers) {
+        batch_err += worker.loss;
+    }
+    return batch_err / dataloader.batch_size;
+}
+
+const Matrix& Model::forward(Workspace& workspace) {
+    auto& activations = workspace.activation_buffers;
+    for (size_t i = 0; i < layers.size(); i++) {
+        layers[i]->forward(*activations[i], *activations[i + 1]);
+    }
+    return *activations.back();
+}
+
+float Model::forward_backward(const std::vector<Layer*>& worker_layers, const Matrix& inputs, const CsrMatrix* sparse_inputs,
+                              const Matrix& truths, Workspace& workspace, Tracer::Lane* lane) {
+    auto& gradients = workspace.gradient_buffers;
+    auto activation = [&](size_t i) -> Matrix& { return *workspace.activation_buffers[i]; };
+    // inputs stand in for activations[0], which may live outside the workspace
+    const Matrix* first_input = sparse_inputs ? &activation(0) : &inputs;
+    auto input_of = [&](size_t i) -> const Matrix& { return i == 0 ? *first_input : activation(i); };
+    std::size_t rows = truths.shape()[0];
+    bool sparse_path = false;
+
+    auto layer_forward = [&](size_t i) {
+        int64_t start = lane ? Tracer::now_ns() : 0;
+        if (i == 0 && sparse_inputs) {
+            sparse_path = forward_sparse_inputs(*worker_layers[0], *sparse_inputs, workspace, activation(1));
+        } else {
+            worker_layers[i]->forward(input_of(i), activation(i + 1));
+        }
+        if (lane) {
+            lane->record(i, Tracer::Phase::Forward, start, Tracer::now_ns(),
+                         worker_layers[i]->flops(rows, input_of(i).shape()[1], false),
+                         layer_bytes(input_of(i), activation(i + 1), tracer.parameter_count(i), false));
+        }
+    };
+
+    // with softmax + cross-entropy the Softmax layer is folded into the loss, which takes the logits
+    size_t n_layers = softmax_cross_entropy ? worker_layers.size() - 1 : worker_layers.size();
+    for (size_t i = 0; i < n_layers; i++) {
+        layer_forward(i);
     }
     
-    xt::xarray<float> predicted = xt::argmax(curr, {1});
-    auto batch_err = loss->forward(predicted, truths);
-    
-    xt::xarray<float> grad;
+    const Matrix& outputs = input_of(n_layers);
+    int64_t loss_start = lane ? Tracer::now_ns() : 0;
+    float batch_err;
     if (softmax_cross_entropy) {
-        auto cross_entropy_loss = dynamic_cast<loss::CrossEntropy*>(loss.get());
-        grad = cross_entropy_loss->backward_fused(curr, truths);
+        auto cross_entropy_loss = static_cast<loss::CrossEntropy*>(loss.get());
+        batch_err = cross_entropy_loss->forward_backward_logits(outputs, truths, *gradients[n_layers]);
+    } else {
+        batch_err = loss->forward(outputs, truths);
+        loss->backward(outputs, truths, *gradients[n_layers]);
+    }
+    if (lane) {
+        lane->record(0, Tracer::Phase::Loss, loss_start, Tracer::now_ns(), 0.0,
+                     sizeof(float) * (2.0 * outputs.size() + truths.size()));
+    }
 
-        for (int j = layers.size() - 2; j >= 0; j--) {
-            grad = layers[j]->backward(grad, dynamic_lr);
+    // the last segment is still in its buffers; every earlier one is run
+    // again from its kept input when backward reaches its last layer
+    size_t segment = workspace.segment;
+    size_t last_segment = (n_layers - 1) / segment * segment;
+    for (int j = n_layers - 1; j >= 0; j--) {
+        if (segment > 1 && static_cast<size_t>(j) < last_segment && j % segment == segment - 1) {
+            for (size_t i = j + 1 - segment; i < static_cast<size_t>(j); i++) {
+                layer_forward(i);
+            }
         }
+        int64_t start = lane ? Tracer::now_ns() : 0;
+        if (j == 0 && sparse_path) {
+            worker_layers[0]->backward_sparse(*sparse_inputs, activation(1), *gradients[1]);
+        } else {
+            worker_layers[j]->backward(input_of(j), activation(j + 1), *gradients[j + 1], *gradients[j]);
+        }
+        if (lane) {
+            lane->record(j, Tracer::Phase::Backward, start, Tracer::now_ns(),
+                         worker_layers[j]->flops(rows, input_of(j).shape()[1], true),
+                         layer_bytes(input_of(j), activation(j + 1), tracer.parameter_count(j), true));
+        }
+    }
+    return batch_err;
+}
+
+float Model::forward_backward_mixed(const std::vector<Layer*>& worker_layers, const Matrix& inputs,
+                                    const Matrix& truths, Workspace& workspace, Tracer::Lane* lane) {
+    auto& stored = workspace.stored;
+    auto& gradients = workspace.gradient_buffers;
+    // fp32 activations live in shared buffers, valid until the next layer of the same width overwrites them
+    auto activation = [&](size_t i) -> Matrix& { return *workspace.activation_buffers[i]; };
+    auto input_of = [&](size_t i) -> const Matrix& { return i == 0 ? inputs : activation(i); };
+    std::size_t rows = inputs.shape()[0];
+
+    size_t n_layers = softmax_cross_entropy ? worker_layers.size() - 1 : worker_layers.size();
+    kernels::to_bf16_rows(inputs.data(), stored[0].data(), rows, inputs.shape()[1], stored[0].shape()[1]);
+    for (size_t i = 0; i < n_layers; i++) {
+        int64_t start = lane ? Tracer::now_ns() : 0;
+        if (!worker_layers[i]->forward_bf16(stored[i], activation(i + 1))) {
+            worker_layers[i]->forward(input_of(i), activation(i + 1));
+        }
+        if (i + 1 < n_layers) {
+            const Matrix& output = activation(i + 1);
+            kernels::to_bf16_rows(output.data(), stored[i + 1].data(), rows, output.shape()[1], stored[i + 1].shape()[1]);
+        }
+        if (lane) {
+            lane->record(i, Tracer::Phase::Forward, start, Tracer::now_ns(),
+                         worker_layers[i]->flops(rows, input_of(i).shape()[1], false),
+                         layer_bytes(input_of(i), activation(i + 1), tracer.parameter_count(i), false));
+        }
+    }
+
+    const Matrix& outputs = input_of(n_layers);
+    int64_t loss_start = lane ? Tracer::now_ns() : 0;
+    float batch_err;
+    if (softmax_cross_entropy) {
+        auto cross_entropy_loss = static_cast<loss::CrossEntropy*>(loss.get());
+        batch_err = cross_entropy_loss->forward_backward_logits(outputs, truths, *gradients[n_layers]);
     } else {
-        grad = loss->backward(curr, truths);
+        batch_err = loss->forward(outputs, truths);
+        loss->backward(outputs, truths, *gradients[n_layers]);
+    }
+    if (lane) {
+        lane->record(0, Tracer::Phase::Loss, loss_start, Tracer::now_ns(), 0.0,
+                     sizeof(float) * (2.0 * outputs.size() + truths.size()));
+    }
 
-        for (int j = layers.size() - 1; j >= 0; j--) {
-            grad = layers[j]->backward(grad, dynamic_lr);
+    // the last layer's input and output are still exact; every earlier input
+    // comes back from bf16, its output having been restored one step before
+    for (int j = n_layers - 1; j >= 0; j--) {
+        int64_t start = lane ? Tracer::now_ns() : 0;
+        if (j > 0 && j + 1 < static_cast<int>(n_layers)) {
+            Matrix& input = activation(j);
+            kernels::from_bf16_rows(stored[j].data(), input.data(), rows, input.shape()[1], stored[j].shape()[1]);
+        }
+        worker_layers[j]->backward(input_of(j), activation(j + 1), *gradients[j + 1], *gradients[j]);
+        if (lane) {
+            lane->record(j, Tracer::Phase::Backward, start, Tracer::now_ns(),
+                         worker_layers[j]->flops(rows, input_of(j).shape()[1], true),
+                         layer_bytes(input_of(j), activation(j + 1), tracer.parameter_count(j), true));
         }
     }
     return batch_err;
 }
 
-std::tuple<float, uint> Model::validation_step(xt::xarray<float>& inputs, xt::xarray<float>& truths) {
-    auto curr = inputs;
-    for (auto& layer : layers) {
-        curr = layer->forward(curr);
+std::tuple<float, uint> Model::validation_step(Workspace& workspace, bool sparse) {
+    auto& activations = workspace.activation_buffers;
+
+    size_t n_layers = softmax_cross_entropy ? layers.size() - 1 : layers.size();
+    for (size_t i = 0; i < n_layers; i++) {
+        if (i == 0 && sparse) {
+            forward_sparse_inputs(*layers[0], workspace.sparse_inputs, workspace, *activations[1]);
+        } else {
+            layers[i]->forward(*activations[i], *activations[i + 1]);
+        }
     }
     
-    xt::xarray<size_t> predicted = xt::argmax(curr, {1});
-    auto batch_err = loss->forward(predicted, truths);
+    // softmax is monotonic, so the logits give the same predictions
+    const Matrix& outputs = *activations[n_layers];
+    float batch_err;
+    if (softmax_cross_entropy) {
+        batch_err = static_cast<loss::CrossEntropy*>(loss.get())->forward_logits(outputs, workspace.truths);
+    } else {
+        batch_err = loss->forward(outputs, workspace.truths);
+    }
 
-    auto matches = xt::equal(predicted, truths);
-    auto correct_predictions = xt::sum(matches)();
+    size_t num_classes = outputs.shape()[1];
+    unsigned int correct_predictions = 0;
+    for (size_t i = 0; i < outputs.shape()[0]; i++) {
+        const float* row = outputs.data() + i * num_classes;
+        size_t predicted = std::max_element(row, row + num_classes) - row;
+        correct_predictions += predicted == static_cast<size_t>(workspace.truths(i, 0));
+    }
     return {batch_err, correct_predictions};
 }
 
@@ -114,7 +852,10 @@ void ProgressBar::update(int epoch, float batch_err, double elapsed_time_s_doubl
     int remaining_seconds = static_cast<int>(remaining_time_s_double) % 60;
 
     std::cout << "\rEpoch " << epoch + 1 << "/" << epochs << " | "
-              << "[" << std::string(pos, '=') << std::string(bar_width - pos, ' ') << "] "
+              << "[";
+    std::fill_n(std::ostreambuf_iterator<char>(std::cout), pos, '=');
+    std::fill_n(std::ostreambuf_iterator<char>(std::cout), bar_width - pos, ' ');
+    std::cout << "] "
               << batch_done << "/" << total_batches
               << " [" << std::setfill('0') << std::setw(2) << elapsed_minutes << ":" 
               << std::setfill('0') << std::setw(2) << elapsed_seconds << "<" 
@@ -0,0 +1,113 @@
+#include "optimizer.hpp"
+#include <cmath>
+#include <memory>
+
+
+namespace optim {
+
+    void Optimizer::ensure_state(AlignedBuffer& state, std::size_t state_size, std::size_t size) {
+        if (!state || state_size != size) {
+            state = make_aligned_buffer(size);
+        }
+    }
+
+    void SGD::step(ParameterArena& arena, float lr, float grad_scale) {
+        std::size_t n = arena.size();
+        float* __restrict w = std::assume_aligned<arena_alignment>(arena.values());
+        const float* __restrict g = std::assume_aligned<arena_alignment>(arena.gradients());
+        const float step_size = lr * grad_scale;
+
+        if (momentum == 0.0f) {
+            for (std::size_t i = 0; i < n; i++) {
+                w[i] -= step_size * g[i];
+            }
+            return;
+        }
+
+        ensure_state(velocity, state_size, n);
+        state_size = n;
+        float* __restrict v = std::assume_aligned<arena_alignment>(velocity.get());
+
+        // separate loops so each one vectorizes without a branch
+        if (nesterov) {
+            for (std::size_t i = 0; i < n; i++) {
+                float gi = grad_scale * g[i];
+                v[i] = momentum * v[i] + gi;
+                w[i] -= lr * (gi + momentum * v[i]);
+            }
+        } else {
+            for (std::size_t i = 0; i < n; i++) {
+                v[i] = momentum * v[i] + grad_scale * g[i];
+                w[i] -= lr * v[i];
+            }
+        }
+    }
+
+    std::vector<float*> SGD::state(std::size_t size) {
+        if (momentum == 0.0f) {
+            return {};
+        }
+        ensure_state(velocity, state_size, size);
+        state_size = size;
+        return {velocity.get()};
+    }
+
+    void Adam::step(ParameterArena& arena, float lr, float grad_scale) {
+        std::size_t n = arena.size();
+        if (state_size != n) {
+            t = 0;
+        }
+        ensure_state(first_moment, state_size, n);
+        ensure_state(second_moment, state_size, n);
+        state_size = n;
+        t++;
+
+        float* __restrict w = std::assume_aligned<arena_alignment>(arena.values());
+        const float* __restrict g = std::assume_aligned<arena_alignment>(arena.gradients());
+        float* __restrict m = std::assume_aligned<arena_alignment>(first_moment.get());
+        float* __restrict v = std::assume_aligned<arena_alignment>(second_moment.get());
+
+        // bias corrections folded into the step size and epsilon
+        const float bias1 = 1.0f - std::pow(beta1, static_cast<float>(t));
+        const float bias2 = 1.0f - std::pow(beta2, static_cast<float>(t));
+        const float step_size = lr * std::sqrt(bias2) / bias1;
+        const float epsilon_hat = epsilon * std::sqrt(bias2);
+        const float decay = 1.0f - lr * weight_decay;
+
+        for (std::size_t i = 0; i < n; i++) {
+            float gi = grad_scale * g[i];
+            m[i] = beta1 * m[i] + (1.0f - beta1) * gi;
+            v[i] = beta2 * v[i] + (1.0f - beta2) * gi * gi;
+            w[i] = decay * w[i] - step_size * m[i] / (std::sqrt(v[i]) + epsilon_hat);
+        }
+    }
+
+    std::vector<float*> Adam::state(std::size_t size) {
+        if (state_size != size) {
+            t = 0;
+        }
+        ensure_state(first_moment, state_size, size);
+        ensure_state(second_moment, state_size, size);
+        state_size = size;
+        return {first_moment.get(), second_moment.get()};
+    }
+
+    std::unique_ptr<Optimizer> make_optimizer(const nlohmann::json& config) {
+        std::string name = config.value("optimizer", "sgd");
+        float momentum = config.value("momentum", 0.0f);
+        float beta1 = config.value("beta1", 0.9f);
+        float beta2 = config.value("beta2", 0.999f);
+        float epsilon = config.value("epsilon", 1e-8f);
+
+        if (name == "sgd") {
+            return std::make_unique<SGD>(momentum);
+        } else if (name == "nesterov") {
+            return std::make_unique<SGD>(momentum, true);
+        } else if (name == "adam") {
+            return std::make_unique<Adam>(beta1, beta2, epsilon);
+        } else if (name == "adamw") {
+            return std::make_unique<AdamW>(config.value("decoupled_weight_decay", 1e-2f), beta1, beta2, epsilon);
+        }
+        throw std::runtime_error("Unknown optimizer: " + name);
+    }
+}
@@ -0,0 +1,107 @@
+#include "parameter.hpp"
+#include <cstdint>
+#include <cstring>
+
+
+AlignedBuffer make_aligned_buffer(std::size_t count) {
+    std::size_t bytes = std::max<std::size_t>(count * sizeof(float), 1);
+    bytes = (bytes + arena_alignment - 1) / arena_alignment * arena_alignment;
+    auto data = static_cast<float*>(std::aligned_alloc(arena_alignment, bytes));
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    std::memset(data, 0, bytes);
+    return AlignedBuffer(data);
+}
+
+Parameter::Parameter(std::size_t rows, std::size_t cols)
+    : storage(2 * rows * cols, 0.0f), rows(rows), cols(cols),
+      value(storage.data()), gradient(storage.data() + rows * cols) {}
+
+void Parameter::bind(float* value_slot, float* gradient_slot) {
+    std::copy_n(value, size(), value_slot);
+    std::copy_n(gradient, size(), gradient_slot);
+    value = value_slot;
+    gradient = gradient_slot;
+    storage = std::vector<float>();
+}
+
+void Parameter::share(float* value_slot, float* gradient_slot) {
+    value = value_slot;
+    gradient = gradient_slot;
+    storage = std::vector<float>();
+}
+
+std::size_t ParameterArena::padded_size(std::size_t size) {
+    const std::size_t floats_per_line = arena_alignment / sizeof(float);
+    return (size + floats_per_line - 1) / floats_per_line * floats_per_line;
+}
+
+void ParameterArena::bind(const std::vector<Parameter*>& parameters) {
+    std::size_t total = 0;
+    for (auto parameter : parameters) {
+        total += padded_size(parameter->size());
+    }
+
+    // parameters may currently live in the old buffers, so keep them until all are copied
+    AlignedBuffer new_values = make_aligned_buffer(total);
+    AlignedBuffer new_gradients = make_aligned_buffer(total);
+
+    std::size_t offset = 0;
+    for (auto parameter : parameters) {
+        parameter->bind(new_values.get() + offset, new_gradients.get() + offset);
+        offset += padded_size(parameter->size());
+    }
+
+    value_buffer = std::move(new_values);
+    gradient_buffer = std::move(new_gradients);
+    value_owner.reset();
+    value_data = value_buffer.get();
+    count = total;
+}
+
+void ParameterArena::bind_shared(const std::vector<Parameter*>& parameters, ParameterArena& master) {
+    gradient_buffer = make_aligned_buffer(master.size());
+    value_buffer = nullptr;
+    value_data = master.values();
+    count = master.size();
+
+    std::size_t offset = 0;
+    for (auto parameter : parameters) {
+        if (offset + parameter->size() > count) {
+            throw std::runtime_error("ParameterArena: replica does not match the master layout.");
+        }
+        parameter->share(value_data + offset, gradient_buffer.get() + offset);
+        offset += padded_size(parameter->size());
+    }
+}
+
+void ParameterArena::bind_external(const std::vector<Parameter*>& parameters, float* values, std::size_t size,
+                                   std::shared_ptr<void> owner) {
+    std::size_t total = 0;
+    for (auto parameter : parameters) {
+        total += padded_size(parameter->size());
+    }
+    if (total != size) {
+        throw std::runtime_error("ParameterArena: external values do not match the parameter layout.");
+    }
+    if (reinterpret_cast<std::uintptr_t>(values) % arena_alignment != 0) {
+        throw std::runtime_error("ParameterArena: external values are not aligned.");
+    }
+
+    gradient_buffer = make_aligned_buffer(total);
+    value_buffer = nullptr;
+    value_owner = std::move(owner);
+    value_data = values;
+    count = total;
+
+    std::size_t offset = 0;
+    for (auto parameter : parameters) {
+        parameter->share(value_data + offset, gradient_buffer.get() + offset);
+        offset += padded_size(parameter->size());
+    }
+}
+
+void ParameterArena::zero_gradients() {
+    std::memset(gradient_buffer.get(), 0, count * sizeof(float));
+}
@@ -0,0 +1,146 @@
+#include "predictor.hpp"
+
+
+Predictor::Predictor(Prepare prepare, Run run, std::size_t max_batch_size, std::chrono::microseconds max_delay)
+    : prepare(std::move(prepare)), run(std::move(run)),
+      max_batch_size(max_batch_size), max_delay(max_delay),
+      batch_fill(max_batch_size + 1, 0)
+{
+    if (max_batch_size == 0) {
+        throw std::runtime_error("Predictor: max_batch_size must be >= 1.");
+    }
+    std::size_t buckets = 1;
+    while ((std::size_t(1) << (buckets - 1)) < max_batch_size) {
+        buckets++;
+    }
+    workspaces.resize(buckets);
+    dispatcher = std::thread(&Predictor::dispatch, this);
+}
+
+Predictor::~Predictor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    dispatcher.join();
+}
+
+std::future<std::vector<float>> Predictor::submit(std::vector<float> features) {
+    Request request{std::move(features), {}, std::chrono::steady_clock::now()};
+    auto future = request.promise.get_future();
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (input_size == 0) {
+            input_size = request.features.size();
+        }
+        if (request.features.size() != input_size || stopping) {
+            request.promise.set_exception(std::make_exception_ptr(std::runtime_error(
+                stopping ? "Predictor: shutting down." : "Predictor: sample has the wrong number of features.")));
+            return future;
+        }
+        queue.push_back(std::move(request));
+        // only the first request of a batch starts the dispatcher's clock, and a full batch stops it
+        wake = queue.size() == 1 || queue.size() >= max_batch_size;
+    }
+    if (!wake) {
+        return future;
+    }
+    queue_cv.notify_one();
+    return future;
+}
+
+void Predictor::dispatch() {
+    std::vector<Request> batch;
+    batch.reserve(max_batch_size);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+
+            auto deadline = queue.front().submitted + max_delay;
+            queue_cv.wait_until(lock, deadline, [this] { return stopping || queue.size() >= max_batch_size; });
+
+            std::size_t n = std::min(queue.size(), max_batch_size);
+            for (std::size_t i = 0; i < n; i++) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        run_batch(batch);
+        batch.clear();
+    }
+}
+
+void Predictor::run_batch(std::vector<Request>& batch) {
+    std::size_t n = batch.size();
+    std::size_t bucket = 0;
+    while ((std::size_t(1) << bucket) < n) {
+        bucket++;
+    }
+    std::size_t rows = std::min(std::size_t(1) << bucket, max_batch_size);
+    std::size_t features = batch.front().features.size();
+
+    const Matrix* outputs = nullptr;
+    std::exception_ptr error;
+    try {
+        Workspace& workspace = workspaces[bucket];
+        prepare(workspace, rows, features);
+
+        // padding rows are zeros; their outputs are dropped
+        Matrix& inputs = workspace.activations.front();
+        for (std::size_t i = 0; i < n; i++) {
+            std::copy(batch[i].features.begin(), batch[i].features.end(), inputs.data() + i * features);
+        }
+        std::fill(inputs.data() + n * features, inputs.data() + rows * features, 0.0f);
+
+        outputs = &run(workspace);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // recorded before any future is ready, so a caller that got its result is counted
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        for (auto& request : batch) {
+            latency.record(now - request.submitted);
+        }
+        batch_fill[n]++;
+    }
+
+    for (std::size_t i = 0; i < n; i++) {
+        if (error) {
+            batch[i].promise.set_exception(error);
+        } else {
+            std::size_t width = outputs->shape()[1];
+            batch[i].promise.set_value(std::vector<float>(outputs->data() + i * width, outputs->data() + (i + 1) * width));
+        }
+    }
+}
+
+PredictionStats Predictor::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    PredictionStats result;
+    result.requests = latency.count();
+    result.p50_us = latency.percentile(0.50);
+    result.p99_us = latency.percentile(0.99);
+    result.batch_fill = batch_fill;
+    for (std::size_t n = 0; n < batch_fill.size(); n++) {
+        result.batches += batch_fill[n];
+    }
+    result.mean_batch_size = result.batches ? static_cast<double>(result.requests) / result.batches : 0.0;
+    return result;
+}
+
+void Predictor::reset_stats() {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    latency.reset();
+    std::fill(batch_fill.begin(), batch_fill.end(), 0);
+}
@@ -0,0 +1,168 @@
+#include "quantization.hpp"
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+    // Rows quantized, multiplied and written back per pass, so the int8 and
+    // int32 intermediates of a tile stay in L1/L2.
+    constexpr std::size_t tile_rows = 32;
+
+    // Per-thread intermediates, grown on first use and then reused.
+    struct Scratch {
+        std::unique_ptr<uint8_t[], void (*)(void*)> quantized{nullptr, std::free};
+        std::size_t quantized_capacity = 0;
+        std::vector<int32_t> accumulators;
+        std::vector<float> values;
+
+        uint8_t* reserve_quantized(std::size_t bytes) {
+            if (bytes > quantized_capacity) {
+                bytes = (bytes + kernels::int8_k_alignment - 1) / kernels::int8_k_alignment * kernels::int8_k_alignment;
+                quantized.reset(static_cast<uint8_t*>(std::aligned_alloc(kernels::int8_k_alignment, bytes)));
+                if (!quantized) {
+                    throw std::bad_alloc();
+                }
+                // padding columns are multiplied by zero weights, but keep them defined
+                std::memset(quantized.get(), 0, bytes);
+                quantized_capacity = bytes;
+            }
+            return quantized.get();
+        }
+    };
+}
+
+QuantizationParams QuantizationParams::from_range(float min, float max) {
+    // the range must contain 0 so that zero (ReLU outputs, padding) is exact
+    min = std::min(min, 0.0f);
+    max = std::max(max, 0.0f);
+    QuantizationParams params;
+    params.scale = max > min ? (max - min) / kernels::activation_qmax : 1.0f;
+    params.zero_point = std::round(-min / params.scale);
+    return params;
+}
+
+void ActivationRange::observe(const float* values, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+    }
+}
+
+void QuantizedDenseLayer::add_stage(const DenseLayer& dense, kernels::Activation kind, float alpha,
+                                    const ActivationRange& input_range) {
+    Stage stage;
+    stage.output_size = dense.weights.rows;
+    stage.input_size = dense.weights.cols;
+    stage.k_padded = kernels::int8_padded(stage.input_size);
+    stage.input = QuantizationParams::from_range(input_range.min, input_range.max);
+    stage.ops = &kernels::activation_kernels(kind);
+    stage.alpha = alpha;
+
+    if (!stages.empty() && stages.back().output_size != stage.input_size) {
+        throw std::runtime_error("QuantizedDenseLayer: stage input does not match the previous output.");
+    }
+
+    std::size_t bytes = stage.output_size * stage.k_padded;
+    stage.weights.reset(static_cast<int8_t*>(std::aligned_alloc(kernels::int8_k_alignment, bytes)));
+    if (!stage.weights) {
+        throw std::bad_alloc();
+    }
+    std::memset(stage.weights.get(), 0, bytes);
+    stage.output_scales.resize(stage.output_size);
+    stage.biases.resize(stage.output_size);
+
+    // symmetric per-channel weights: w ~ weight_scale * q, q in [-127, 127]
+    for (std::size_t o = 0; o < stage.output_size; o++) {
+        const float* row = dense.weights.value + o * stage.input_size;
+        float max_abs = 0.0f;
+        for (std::size_t k = 0; k < stage.input_size; k++) {
+            max_abs = std::max(max_abs, std::abs(row[k]));
+        }
+        float weight_scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+
+        int8_t* quantized = stage.weights.get() + o * stage.k_padded;
+        int32_t sum = 0;
+        for (std::size_t k = 0; k < stage.input_size; k++) {
+            quantized[k] = static_cast<int8_t>(std::lround(row[k] / weight_scale));
+            sum += quantized[k];
+        }
+
+        // y = s_x * s_w * (acc - z_x * sum(q_w)) + b, the zero-point term folded into the bias
+        stage.output_scales[o] = stage.input.scale * weight_scale;
+        stage.biases[o] = dense.biases.value[o] - stage.output_scales[o] * stage.input.zero_point * sum;
+    }
+    stages.push_back(std::move(stage));
+}
+
+std::size_t QuantizedDenseLayer::weight_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto& stage : stages) {
+        bytes += stage.output_size * stage.input_size + 2 * stage.output_size * sizeof(float);
+    }
+    return bytes;
+}
+
+std::size_t QuantizedDenseLayer::output_size(std::size_t input_size) const {
+    if (stages.empty() || input_size != stages.front().input_size) {
+        throw std::runtime_error("QuantizedDenseLayer: unexpected input size " + std::to_string(input_size) + ".");
+    }
+    return stages.back().output_size;
+}
+
+void QuantizedDenseLayer::forward(const Matrix& inputs, Matrix& outputs) {
+    thread_local Scratch scratch;
+    std::size_t batch_size = inputs.shape()[0];
+
+    // two int8 activation buffers used in turn: the input of a stage and the input of the next
+    std::size_t widest = 0;
+    for (const auto& stage : stages) {
+        widest = std::max(widest, stage.k_padded);
+    }
+    std::size_t buffer_bytes = tile_rows * widest;
+    uint8_t* buffers = scratch.reserve_quantized(2 * buffer_bytes);
+    std::size_t widest_output = 0;
+    for (const auto& stage : stages) {
+        widest_output = std::max(widest_output, stage.output_size);
+    }
+    scratch.accumulators.resize(tile_rows * widest_output);
+    scratch.values.resize(widest_output);
+
+    for (std::size_t start = 0; start < batch_size; start += tile_rows) {
+        std::size_t rows = std::min(tile_rows, batch_size - start);
+
+        const Stage& first = stages.front();
+        uint8_t* stage_input = buffers;
+        for (std::size_t i = 0; i < rows; i++) {
+            kernels::quantize_activations(inputs.data() + (start + i) * first.input_size,
+                                          stage_input + i * first.k_padded, first.input_size,
+                                          1.0f / first.input.scale, first.input.zero_point);
+        }
+
+        for (std::size_t s = 0; s < stages.size(); s++) {
+            const Stage& stage = stages[s];
+            const Stage* next = s + 1 < stages.size() ? &stages[s + 1] : nullptr;
+            uint8_t* next_input = stage_input == buffers ? buffers + buffer_bytes : buffers;
+            int32_t* acc = scratch.accumulators.data();
+            gemm(stage_input, stage.weights.get(), acc, rows, stage.output_size, stage.k_padded);
+
+            // epilogue: dequantize, bias + activation, then requantize for the next stage or store
+            for (std::size_t i = 0; i < rows; i++) {
+                float* y = next ? scratch.values.data() : outputs.data() + (start + i) * stage.output_size;
+                const int32_t* acc_row = acc + i * stage.output_size;
+                for (std::size_t o = 0; o < stage.output_size; o++) {
+                    y[o] = static_cast<float>(acc_row[o]) * stage.output_scales[o];
+                }
+                stage.ops->forward_bias(y, stage.biases.data(), y, stage.output_size, stage.alpha);
+                if (next) {
+                    kernels::quantize_activations(y, next_input + i * next->k_padded, stage.output_size,
+                                                  1.0f / next->input.scale, next->input.zero_point);
+                }
+            }
+            stage_input = next_input;
+        }
+    }
+}
+
+void QuantizedDenseLayer::backward(const Matrix&, const Matrix&, const Matrix&, Matrix&) {
+    throw std::runtime_error("QuantizedDenseLayer is inference only.");
+}
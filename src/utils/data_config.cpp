@@ -0,0 +1,135 @@
+#include "utils/data_config.hpp"
+#include "utils/idx_dataset.hpp"
+#include "utils/dataset_cache.hpp"
+#include <numeric>
+
+namespace {
+    CsvOptions csv_options(const nlohmann::json& config) {
+        CsvOptions options;
+        options.delimiter = config.value("csv_delimiter", std::string(",")).at(0);
+        options.header = config.value("csv_header", false);
+        options.label_column = config.value("csv_label_column", -1);
+        options.feature_columns = config.value("csv_feature_columns", std::vector<int>());
+        if (config.value("csv_labels", "categorical") == "index") {
+            options.labels = CsvOptions::Labels::Index;
+        }
+        return options;
+    }
+
+    // The dataset of `config` from the cache in `directory`, loaded and
+    // written there first if no cache matches the source files and options.
+    // Samples are shuffled once when written, mnist excepted, so the splits
+    // stay the same from run to run.
+    std::shared_ptr<CachedSource> cached_dataset(const nlohmann::json& config, const std::string& directory) {
+        std::string name = config.value("dataset", "iris");
+        std::vector<std::string> paths;
+        nlohmann::json parameters = {{"dataset", name}};
+        if (name == "mnist") {
+            paths = {config.value("mnist_images_path", "../data/train-images-idx3-ubyte"),
+                     config.value("mnist_labels_path", "../data/train-labels-idx1-ubyte")};
+        } else if (name == "csv") {
+            paths = {config.value("csv_path", "../data/train.csv")};
+            for (const char* option : {"csv_delimiter", "csv_header", "csv_label_column", "csv_feature_columns", "csv_labels"}) {
+                parameters[option] = config.value(option, nlohmann::json());
+            }
+        } else {
+            paths = {"../data/Iris/iris.data"};
+        }
+
+        uint64_t key = dataset_cache::key(paths, parameters.dump());
+        std::string path = dataset_cache::path(directory, key);
+        if (auto cached = CachedSource::open(path, key)) {
+            return cached;
+        }
+
+        std::shared_ptr<const SampleSource> source;
+        std::size_t classes = 0;
+        ImageShape shape{};
+        if (name == "mnist") {
+            auto idx = std::make_shared<IdxSource>(paths[0], paths[1]);
+            classes = idx->n_classes();
+            shape = idx->image_shape();
+            source = idx;
+        } else {
+            CsvDataset dataset(paths[0], name == "csv" ? csv_options(config) : CsvOptions());
+            classes = dataset.n_classes;
+            source = dataset.source();
+        }
+
+        std::vector<std::size_t> order(source->size());
+        if (name == "mnist") {
+            std::iota(order.begin(), order.end(), 0);
+        } else {
+            // seeded by the key (never 0, which would draw a seed) so a rewrite shuffles alike
+            RandomSampler(source->size(), key | 1).epoch_indices(0, order);
+        }
+        std::cout << "Writing dataset cache " << path << std::endl;
+        dataset_cache::write(path, key, *source, classes, shape, order);
+        return CachedSource::open(path, key);
+    }
+}
+
+DataSplits load_data_splits(const nlohmann::json& config) {
+    float validation_split = config.value("validation_split", 0.2);
+    unsigned int train_batch_size = config.value("train_batch_size", 4);
+    unsigned int val_batch_size = config.value("val_batch_size", 4);
+
+    DataSplits splits;
+    std::string cache_directory = config.value("dataset_cache", "");
+    if (!cache_directory.empty() && config.value("dataset", "iris") == "svmlight") {
+        std::cerr << "dataset_cache: svmlight datasets are loaded without the cache" << std::endl;
+        cache_directory.clear();
+    }
+
+    if (!cache_directory.empty()) {
+        auto source = cached_dataset(config, cache_directory);
+        if (!source) {
+            throw std::runtime_error("dataset_cache: unable to read the cache written in " + cache_directory);
+        }
+        // the proportions of the uncached splits: a test tenth is held out, except for mnist
+        float test_split = config.value("dataset", "iris") == "mnist" ? 0.0f : 0.1f;
+        std::size_t val_size = static_cast<std::size_t>(source->size() * validation_split);
+        std::size_t test_size = static_cast<std::size_t>(source->size() * test_split);
+        std::size_t train_size = source->size() - val_size - test_size;
+        splits.train = std::make_unique<Dataloader>(source->slice(0, train_size), train_batch_size);
+        splits.val = std::make_unique<Dataloader>(source->slice(train_size, val_size), val_batch_size);
+        splits.n_classes = source->n_classes();
+        splits.image_shape = source->image_shape();
+    } else if (config.value("dataset", "iris") == "mnist") {
+        // memory-mapped, converted to float one batch at a time
+        auto source = std::make_shared<IdxSource>(
+            config.value("mnist_images_path", "../data/train-images-idx3-ubyte"),
+            config.value("mnist_labels_path", "../data/train-labels-idx1-ubyte")
+        );
+        std::size_t val_size = static_cast<std::size_t>(source->size() * validation_split);
+        std::size_t train_size = source->size() - val_size;
+        splits.train = std::make_unique<Dataloader>(source->slice(0, train_size), train_batch_size);
+        splits.val = std::make_unique<Dataloader>(source->slice(train_size, val_size), val_batch_size);
+        splits.n_classes = source->n_classes();
+        splits.image_shape = source->image_shape();
+    } else if (config.value("dataset", "iris") == "svmlight") {
+        SvmLightDataset dataset(config.value("svmlight_path", "../data/train.svm"));
+        auto subsets = dataset.split_dataset(validation_split, 0.1f);
+        splits.train = std::make_unique<Dataloader>(std::move(subsets.train), train_batch_size);
+        splits.val = std::make_unique<Dataloader>(std::move(subsets.val), val_batch_size);
+        splits.n_classes = dataset.n_classes;
+    } else if (config.value("dataset", "iris") == "csv") {
+        CsvDataset dataset(config.value("csv_path", "../data/train.csv"), csv_options(config));
+        auto subsets = dataset.split_dataset(validation_split, 0.1f);
+        splits.train = std::make_unique<Dataloader>(std::move(subsets.train), train_batch_size);
+        splits.val = std::make_unique<Dataloader>(std::move(subsets.val), val_batch_size);
+        splits.n_classes = dataset.n_classes;
+    } else {
+        IrisDataset dataset(
+            "../data/Iris/iris.data"
+        );
+
+        // Split the dataset into training and validation sets
+        auto subsets = dataset.split_dataset(validation_split, 0.1f);
+        splits.train = std::make_unique<Dataloader>(std::move(subsets.train), train_batch_size);
+        splits.val = std::make_unique<Dataloader>(std::move(subsets.val), val_batch_size);
+        splits.n_classes = dataset.n_classes;
+    }
+    splits.train->set_sampler(make_sampler(config, splits.train->labels()));
+    return splits;
+}
@@ -1,86 +1,104 @@
 #include "utils/dataset.hpp"
-#include <xtensor/views/xmasked_view.hpp>
+#include "utils/idx_dataset.hpp"
+#include "utils/thread_pool.hpp"
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-
-uint32_t bswap_32(uint32_t x) {
-    return ((x & 0xFF000000) >> 24) |
-           ((x & 0x00FF0000) >> 8)  |
-           ((x & 0x0000FF00) << 8)  |
-           ((x & 0x000000FF) << 24);
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+    // labels are kept as a (samples, 1) column so batches slice like the inputs
+    Matrix label_column(const xt::xarray<uint>& labels, std::size_t n_samples) {
+        if (n_samples != labels.size()) {
+            throw std::runtime_error("Input and output data must have the same number of samples.");
+        }
+        Matrix y_data = xt::empty<float>({labels.size(), std::size_t(1)});
+        std::copy(labels.cbegin(), labels.cend(), y_data.begin());
+        return y_data;
+    }
 }
 
+Subset Subset::of(Matrix data, const xt::xarray<uint>& labels) {
+    Matrix y_data = label_column(labels, data.shape()[0]);
+    Subset subset{std::make_shared<MemorySource>(std::move(data), std::move(y_data)), {}};
+    subset.indices.resize(labels.size());
+    std::iota(subset.indices.begin(), subset.indices.end(), 0);
+    return subset;
+}
 
-std::vector<uint32_t> get_idx_dimension(std::ifstream& file) {
-    // magic number ==> first 2 bytes 00, third byte indicate the type of data and the fourth byte indicate the number of dimensions
-    // size in dimension 0 
-    // size in dimension 1 
-    // size in dimension 2 
-    // ..... 
-    // size in dimension N 
-    // data
-    // Read the IDX file header byte by byte
-    unsigned char zeros[2];
-    unsigned char data_type;
-    unsigned char n_dim_byte;
-
-    file.read(reinterpret_cast<char*>(zeros), 2);
-    file.read(reinterpret_cast<char*>(&data_type), 1);
-    file.read(reinterpret_cast<char*>(&n_dim_byte), 1);
-
-    int n_dim = static_cast<int>(n_dim_byte);
-
-    // Utiliser un vecteur pour stocker les tailles de dimensions de manière générique
-    std::vector<uint32_t> dimensions;
-    for (int i = 0; i < n_dim; ++i) {
-        uint32_t dim_be;
-        file.read(reinterpret_cast<char*>(&dim_be), sizeof(dim_be));
-        uint32_t dim = bswap_32(dim_be);
-        dimensions.push_back(dim);
+std::shared_ptr<const SampleSource> Dataset::source() {
+    if (samples) {
+        return samples;
     }
-
-    return dimensions;
+    Matrix y_data = label_column(labels, sparse_data.rows > 0 ? sparse_data.rows : data.shape()[0]);
+    labels = xt::xarray<uint>();
+
+    if (sparse_data.rows > 0) {
+        samples = std::make_shared<SparseSource>(std::move(sparse_data), std::move(y_data));
+        sparse_data = CsrMatrix();
+    } else {
+        samples = std::make_shared<MemorySource>(std::move(data), std::move(y_data));
+        data = Matrix();
+    }
+    return samples;
 }
 
-std::tuple<xt::xarray<float>, xt::xarray<unsigned char>> load_idx_data(const std::string& image_path, const std::string& label_path) {
-
-    std::ifstream image_file(image_path, std::ios::binary);
-    if (!image_file.is_open()) {
-        std::cerr << "Error: Unable to open image file " << image_path << std::endl;
-        return {};
+std::vector<Fold> Dataset::k_folds(std::size_t k, uint64_t seed) {
+    auto shared = source();
+    std::size_t total_samples = shared->size();
+    if (k < 2 || k > total_samples) {
+        throw std::runtime_error("k_folds: k must be between 2 and the number of samples, got " + std::to_string(k) + ".");
     }
-    std::vector<uint32_t> image_dims = get_idx_dimension(image_file);
-    if (image_dims.size() != 3) {
-        std::cerr << "Error: Expected 3 dimensions for images, but got " << image_dims.size() << std::endl;
-        return {};
+
+    std::vector<std::size_t> order;
+    RandomSampler(total_samples, seed).epoch_indices(0, order);
+    // the first total_samples % k parts hold one sample more
+    auto part_start = [&](std::size_t part) { return part * (total_samples / k) + std::min(part, total_samples % k); };
+    std::vector<Fold> folds(k);
+    for (std::size_t i = 0; i < k; i++) {
+        auto begin = order.begin() + part_start(i);
+        auto end = order.begin() + part_start(i + 1);
+        folds[i].val = Subset{shared, std::vector<std::size_t>(begin, end)};
+        folds[i].train = Subset{shared, std::vector<std::size_t>(order.begin(), begin)};
+        folds[i].train.indices.insert(folds[i].train.indices.end(), end, order.end());
     }
+    return folds;
+}
 
-    size_t total_image_pixels = image_dims[0] * image_dims[1] * image_dims[2];
-    xt::xarray<unsigned char> images_uchar(xt::adapt(std::vector<unsigned char>(total_image_pixels), image_dims));
-    image_file.read(reinterpret_cast<char*>(images_uchar.data()), total_image_pixels);
-    
-    // Merge the rows and cols of the images 
-    images_uchar = xt::reshape_view(images_uchar, {image_dims[0], image_dims[1] * image_dims[2]});
+std::tuple<xt::xarray<float>, xt::xarray<unsigned char>> load_idx_data(const std::string& image_path, const std::string& label_path) {
+    try {
+        MappedFile image_file(image_path);
+        std::vector<uint32_t> image_dims = get_idx_dimension(image_file);
+        if (image_dims.size() != 3) {
+            std::cerr << "Error: Expected 3 dimensions for images, but got " << image_dims.size() << std::endl;
+            return {};
+        }
 
-    // --- NORMALIZATION STEP ---
-    xt::xarray<float> images = xt::cast<float>(images_uchar);
-    images /= 255.0f;
-    // -------------------------
+        // Merge the rows and cols of the images, normalized straight from the mapping
+        std::size_t n_images = image_dims[0];
+        std::size_t row_size = static_cast<std::size_t>(image_dims[1]) * image_dims[2];
+        xt::xarray<float> images = xt::empty<float>({n_images, row_size});
+        idx_to_float(image_file.data() + idx_data_offset(3), images.data(), images.size());
+
+        MappedFile label_file(label_path);
+        std::vector<uint32_t> label_dims = get_idx_dimension(label_file);
+        if (label_dims.size() != 1) {
+            std::cerr << "Error: Expected 1 dimension for labels, but got " << label_dims.size() << std::endl;
+            return {};
+        }
+        xt::xarray<unsigned char> labels = xt::empty<unsigned char>({static_cast<std::size_t>(label_dims[0])});
+        std::copy_n(label_file.data() + idx_data_offset(1), labels.size(), labels.data());
 
-    std::ifstream label_file(label_path, std::ios::binary);
-    if (!label_file.is_open()) {
-        std::cerr << "Error: Unable to open label file " << label_path << std::endl;
-        return {};
-    }
-    std::vector<uint32_t> label_dims = get_idx_dimension(label_file);
-    if (label_dims.size() != 1) {
-        std::cerr << "Error: Expected 1 dimension for labels, but got " << label_dims.size() << std::endl;
+        return std::make_tuple(images, labels);
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
         return {};
     }
-    size_t num_labels = label_dims[0];
-    xt::xarray<unsigned char> labels(xt::adapt(std::vector<unsigned char>(num_labels), label_dims));
-    label_file.read(reinterpret_cast<char*>(labels.data()), num_labels);
-
-    return std::make_tuple(images, labels);
 }
 
 
@@ -115,82 +133,277 @@ MNISTDataset::MNISTDataset(
     std::cout << "MNIST data loaded successfully." << std::endl;
 }
 
-IrisDataset::IrisDataset(const std::string &file_path) {
-std::ifstream file(file_path);
-    if (!file.is_open()) {
-        std::cerr << "Error: Unable to open IRIS dataset file " << file_path << std::endl;
-        return;
+namespace {
+    // One newline-aligned slice of a CSV file.
+    struct CsvChunk {
+        const char* begin;
+        const char* end;
+        std::size_t first_row = 0;
+        std::size_t rows = 0;
+        // Categorical labels: the chunk's classes in order of first appearance
+        std::unordered_map<std::string_view, uint> classes;
+        std::vector<std::string_view> class_order;
+    };
+
+    const char* line_end(const char* cursor, const char* end) {
+        auto newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        return newline ? newline : end;
     }
 
-    std::vector<std::vector<float>> features_vec;
-    std::vector<unsigned int> labels_vec;
-
-    std::unordered_map<std::string, unsigned int> label_map;
-    unsigned int next_id = 0;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-
-        std::istringstream ss(line);
-        std::vector<float> feature_row;
-        float value;
-        char comma;
+    // Without the spaces around it, nor the \r of CRLF line endings.
+    std::string_view trimmed(const char* begin, const char* end) {
+        while (begin < end && (*begin == ' ' || *begin == '\t')) {
+            begin++;
+        }
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+            end--;
+        }
+        return std::string_view(begin, end - begin);
+    }
 
-        for (int i = 0; i < 4; ++i) {
-            if (!(ss >> value)) {
-                std::cerr << "Error: Invalid data format in IRIS dataset." << std::endl;
-                return;
+    template <class F>
+    void for_each_line(const char* cursor, const char* end, F&& f) {
+        while (cursor < end) {
+            const char* next = line_end(cursor, end);
+            std::string_view line = trimmed(cursor, next);
+            if (!line.empty()) {
+                f(line);
             }
-            feature_row.push_back(value);
-            ss >> comma;
+            cursor = next + 1;
         }
+    }
+}
 
-        std::string label_str;
-        if (!(ss >> label_str)) {
-            std::cerr << "Error: Missing label in IRIS dataset." << std::endl;
-            return;
+CsvDataset::CsvDataset(const std::string& file_path, const CsvOptions& options) {
+    MappedFile file(file_path);
+    const char* begin = reinterpret_cast<const char*>(file.data());
+    const char* end = begin + file.size();
+    if (options.header && begin < end) {
+        begin = std::min(line_end(begin, end) + 1, end);
+    }
+    auto error = [&](const std::string& message) {
+        return std::runtime_error("CsvDataset: " + message + " in " + file_path);
+    };
+
+    // the first line fixes the columns
+    std::string_view first_line;
+    for (const char* line = begin; line < end && first_line.empty(); line = line_end(line, end) + 1) {
+        first_line = trimmed(line, line_end(line, end));
+    }
+    std::size_t n_columns = std::count(first_line.begin(), first_line.end(), options.delimiter) + 1;
+    if (n_columns < 2) {
+        throw error("expected a label and at least one feature per line");
+    }
+    auto resolve = [&](int column) -> std::size_t {
+        long index = column < 0 ? static_cast<long>(n_columns) + column : column;
+        if (index < 0 || index >= static_cast<long>(n_columns)) {
+            throw error("column " + std::to_string(column) + " out of " + std::to_string(n_columns));
         }
-
-        if (label_map.find(label_str) == label_map.end()) {
-            label_map[label_str] = next_id++;
+        return static_cast<std::size_t>(index);
+    };
+    std::size_t label_column = resolve(options.label_column);
+    std::vector<int> feature_of(n_columns, -1);
+    std::size_t n_features = 0;
+    if (options.feature_columns.empty()) {
+        for (std::size_t c = 0; c < n_columns; c++) {
+            if (c != label_column) {
+                feature_of[c] = n_features++;
+            }
+        }
+    } else {
+        for (int column : options.feature_columns) {
+            std::size_t c = resolve(column);
+            if (c == label_column || feature_of[c] >= 0) {
+                throw error("feature column " + std::to_string(column) + " is the label or listed twice");
+            }
+            feature_of[c] = n_features++;
         }
-
-        features_vec.push_back(std::move(feature_row));
-        labels_vec.push_back(label_map[label_str]);
     }
 
-    std::size_t n = features_vec.size();
-    std::size_t d = 4;
+    std::size_t n_threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    n_threads = std::max<std::size_t>(1, std::min<std::size_t>(n_threads, (end - begin) / (1 << 20)));
+    std::vector<CsvChunk> chunks(n_threads);
+    const char* cursor = begin;
+    for (std::size_t t = 0; t < n_threads; t++) {
+        const char* target = begin + (end - begin) * (t + 1) / n_threads;
+        const char* chunk_end = t + 1 == n_threads ? end : std::min(line_end(std::max(target, cursor), end) + 1, end);
+        chunks[t].begin = cursor;
+        chunks[t].end = chunk_end;
+        cursor = chunk_end;
+    }
 
-    // Flatten features into a contiguous buffer
-    std::vector<float> flat_features;
-    flat_features.reserve(n * d);
-    for (const auto& row : features_vec) {
-        flat_features.insert(flat_features.end(), row.begin(), row.end());
+    WorkerPool pool(n_threads);
+    pool.run([&](std::size_t t) {
+        for_each_line(chunks[t].begin, chunks[t].end, [&](std::string_view) { chunks[t].rows++; });
+    });
+    std::size_t n_rows = 0;
+    for (auto& chunk : chunks) {
+        chunk.first_row = n_rows;
+        n_rows += chunk.rows;
     }
 
-    // Assign to xtensor members
-    this->data   = xt::adapt(flat_features, std::array<std::size_t, 2>{n, d});
-    this->labels = xt::adapt(labels_vec,    std::array<std::size_t, 1>{n});
-    auto& gen = xt::random::get_default_random_engine();
-    xt::random::shuffle(this->data, gen);
-    xt::random::shuffle(this->labels, gen);
-    std::cout << "IRIS dataset loaded successfully. "
-              << "Samples: " << n << ", Features: " << d << std::endl;
+    data = xt::empty<float>({n_rows, n_features});
+    labels = xt::empty<uint>({n_rows});
+    pool.run([&](std::size_t t) {
+        CsvChunk& chunk = chunks[t];
+        std::size_t row = chunk.first_row;
+        for_each_line(chunk.begin, chunk.end, [&](std::string_view line) {
+            float* features = data.data() + row * n_features;
+            const char* field = line.data();
+            const char* line_stop = line.data() + line.size();
+            std::size_t column = 0;
+            while (true) {
+                auto separator = static_cast<const char*>(std::memchr(field, options.delimiter, line_stop - field));
+                const char* field_end = separator ? separator : line_stop;
+                if (column == n_columns) {
+                    column++;
+                    break;
+                }
+                std::string_view value = trimmed(field, field_end);
+                if (column == label_column) {
+                    if (options.labels == CsvOptions::Labels::Index) {
+                        uint label = 0;
+                        auto [parsed, status] = std::from_chars(value.data(), value.data() + value.size(), label);
+                        if (status != std::errc() || parsed != value.data() + value.size()) {
+                            throw error("bad class index \"" + std::string(value) + "\" on data row " + std::to_string(row));
+                        }
+                        labels(row) = label;
+                    } else {
+                        auto [entry, added] = chunk.classes.try_emplace(value, chunk.class_order.size());
+                        if (added) {
+                            chunk.class_order.push_back(value);
+                        }
+                        labels(row) = entry->second;
+                    }
+                } else if (feature_of[column] >= 0) {
+                    auto [parsed, status] = std::from_chars(value.data(), value.data() + value.size(), features[feature_of[column]]);
+                    if (status != std::errc() || parsed != value.data() + value.size() || value.empty()) {
+                        throw error("bad number \"" + std::string(value) + "\" on data row " + std::to_string(row));
+                    }
+                }
+                column++;
+                if (!separator) {
+                    break;
+                }
+                field = separator + 1;
+            }
+            if (column != n_columns) {
+                throw error("data row " + std::to_string(row) + " has " + (column < n_columns ? "fewer" : "more")
+                            + " than " + std::to_string(n_columns) + " columns");
+            }
+            row++;
+        });
+    });
+
+    if (options.labels == CsvOptions::Labels::Index) {
+        n_classes = n_rows > 0 ? *std::max_element(labels.begin(), labels.end()) + 1 : 0;
+    } else {
+        // chunk-local class ids to global ones, numbered in file order
+        std::unordered_map<std::string_view, uint> global;
+        std::vector<std::vector<uint>> to_global(n_threads);
+        for (std::size_t t = 0; t < n_threads; t++) {
+            for (std::string_view name : chunks[t].class_order) {
+                auto [entry, added] = global.try_emplace(name, class_names.size());
+                if (added) {
+                    class_names.emplace_back(name);
+                }
+                to_global[t].push_back(entry->second);
+            }
+        }
+        pool.run([&](std::size_t t) {
+            uint* chunk_labels = labels.data() + chunks[t].first_row;
+            for (std::size_t i = 0; i < chunks[t].rows; i++) {
+                chunk_labels[i] = to_global[t][chunk_labels[i]];
+            }
+        });
+        n_classes = class_names.size();
+    }
+    std::cout << "CSV dataset loaded successfully. Samples: " << n_rows << ", Features: " << n_features
+              << ", Classes: " << n_classes << std::endl;
 }
 
+SvmLightDataset::SvmLightDataset(const std::string& file_path) {
+    std::ifstream file(file_path);
+    if (!file.is_open()) {
+        throw std::runtime_error("SvmLightDataset: unable to open " + file_path);
+    }
 
-xt::xarray<uint> remap_labels(const xt::xarray<unsigned char>& labels) {
-    auto unique_labels = xt::unique(labels);
+    std::vector<double> raw_labels;
+    std::vector<uint32_t> row_columns;
+    std::vector<float> row_values;
+    std::size_t cols = 0;
+    sparse_data.clear(0);
 
-    xt::xarray<uint> remapped = xt::zeros<uint>(labels.shape());
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        std::size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.resize(comment);
+        }
+        const char* cursor = line.c_str();
+        char* end = nullptr;
+        double label = std::strtod(cursor, &end);
+        if (end == cursor) {
+            continue;   // blank line
+        }
+        cursor = end;
+
+        row_columns.clear();
+        row_values.clear();
+        while (true) {
+            unsigned long index = std::strtoul(cursor, &end, 10);
+            if (end == cursor) {
+                break;
+            }
+            if (*end != ':' || index == 0 || (!row_columns.empty() && index - 1 <= row_columns.back())) {
+                throw std::runtime_error("SvmLightDataset: bad feature on line " + std::to_string(line_number)
+                                         + " of " + file_path + ", expected ascending 1-based index:value pairs");
+            }
+            cursor = end + 1;
+            float value = std::strtof(cursor, &end);
+            cursor = end;
+            if (value != 0.0f) {
+                row_columns.push_back(static_cast<uint32_t>(index - 1));
+                row_values.push_back(value);
+            }
+            cols = std::max<std::size_t>(cols, index);
+        }
+        sparse_data.append_row(row_columns.data(), row_values.data(), row_columns.size());
+        raw_labels.push_back(label);
+    }
+    sparse_data.cols = cols;
 
-    for (uint i = 0; i < unique_labels.size(); ++i) {
-        auto mask = xt::equal(labels, unique_labels(i));
-        xt::masked_view(remapped, mask) = i;
+    std::vector<double> classes = raw_labels;
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+    n_classes = classes.size();
+
+    labels = xt::zeros<uint>({raw_labels.size()});
+    for (std::size_t i = 0; i < raw_labels.size(); i++) {
+        labels(i) = static_cast<uint>(std::lower_bound(classes.begin(), classes.end(), raw_labels[i]) - classes.begin());
+    }
+    std::cout << "SVMlight dataset loaded successfully. Samples: " << sparse_data.rows << ", Features: " << cols
+              << ", Non-zeros: " << sparse_data.nnz() << std::endl;
+}
+
+xt::xarray<uint> remap_labels(const xt::xarray<unsigned char>& labels) {
+    // one pass over the labels: classes numbered in ascending order of their byte value
+    std::array<bool, 256> present{};
+    for (unsigned char label : labels) {
+        present[label] = true;
+    }
+    std::array<uint, 256> index{};
+    uint classes = 0;
+    for (std::size_t value = 0; value < present.size(); value++) {
+        if (present[value]) {
+            index[value] = classes++;
+        }
     }
 
-    std::cout << "Remapped labels: " << remapped << std::endl;
+    xt::xarray<uint> remapped = xt::empty<uint>(labels.shape());
+    std::transform(labels.cbegin(), labels.cend(), remapped.begin(), [&](unsigned char label) { return index[label]; });
+    std::cout << "Remapped " << labels.size() << " labels to " << classes << " classes" << std::endl;
     return remapped;
-}
\ No newline at end of file
+}
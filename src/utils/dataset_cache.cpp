@@ -0,0 +1,133 @@
+#include "utils/dataset_cache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+
+namespace {
+    constexpr std::size_t alignment = 64;
+
+    std::size_t aligned(std::size_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    std::size_t labels_offset(std::size_t rows, std::size_t features) {
+        return aligned(sizeof(dataset_cache::Header) + rows * features * sizeof(float));
+    }
+
+    // FNV-1a
+    void mix(uint64_t& hash, const void* data, std::size_t size) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+    }
+}
+
+namespace dataset_cache {
+    uint64_t key(const std::vector<std::string>& source_paths, const std::string& parameters) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        mix(hash, &version, sizeof(version));
+        mix(hash, parameters.data(), parameters.size());
+        for (const auto& source_path : source_paths) {
+            // the contents are not read: hashing a multi-GB source would cost what the cache saves
+            std::filesystem::path file = std::filesystem::absolute(source_path);
+            uint64_t size = std::filesystem::file_size(file);
+            int64_t modified = std::filesystem::last_write_time(file).time_since_epoch().count();
+            std::string name = file.string();
+            mix(hash, name.data(), name.size() + 1);
+            mix(hash, &size, sizeof(size));
+            mix(hash, &modified, sizeof(modified));
+        }
+        return hash;
+    }
+
+    std::string path(const std::string& directory, uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.cache", static_cast<unsigned long long>(key));
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    void write(const std::string& path, uint64_t key, const SampleSource& source, std::size_t classes,
+               const ImageShape& shape, const std::vector<std::size_t>& order) {
+        std::size_t rows = order.size();
+        std::size_t features = source.n_features();
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.classes = static_cast<uint32_t>(classes);
+        header.key = key;
+        header.rows = rows;
+        header.features = features;
+        header.height = static_cast<uint32_t>(shape.height);
+        header.width = static_cast<uint32_t>(shape.width);
+        header.channels = static_cast<uint32_t>(shape.channels);
+
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+        std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("dataset cache: unable to write " + temporary);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        // converted a block of rows at a time, the whole dataset is never in memory as float
+        constexpr std::size_t block_rows = 4096;
+        std::vector<float> x(block_rows * features);
+        std::vector<float> y(rows);
+        for (std::size_t first = 0; first < rows; first += block_rows) {
+            std::size_t n = std::min(block_rows, rows - first);
+            source.gather(order.data() + first, n, x.data(), y.data() + first);
+            out.write(reinterpret_cast<const char*>(x.data()), n * features * sizeof(float));
+        }
+        std::size_t padding = labels_offset(rows, features) - sizeof(Header) - rows * features * sizeof(float);
+        const char zeros[alignment] = {};
+        out.write(zeros, padding);
+        out.write(reinterpret_cast<const char*>(y.data()), rows * sizeof(float));
+
+        out.close();
+        if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("dataset cache: unable to write " + path);
+        }
+    }
+}
+
+std::shared_ptr<CachedSource> CachedSource::open(const std::string& path, uint64_t key) {
+    if (!std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    auto file = std::make_shared<const MappedFile>(path);
+    if (file->size() < sizeof(dataset_cache::Header)) {
+        return nullptr;
+    }
+    dataset_cache::Header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, dataset_cache::magic, sizeof(header.magic)) != 0
+        || header.version != dataset_cache::version || header.key != key
+        || file->size() != labels_offset(header.rows, header.features) + header.rows * sizeof(float)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<CachedSource> source(new CachedSource());
+    source->file = file;
+    source->count = header.rows;
+    source->row_size = header.features;
+    source->classes = header.classes;
+    source->shape = {header.height, header.width, header.channels};
+    source->rows = reinterpret_cast<const float*>(file->data() + sizeof(dataset_cache::Header));
+    source->labels = reinterpret_cast<const float*>(file->data() + labels_offset(header.rows, header.features));
+    return source;
+}
+
+std::shared_ptr<CachedSource> CachedSource::slice(std::size_t first, std::size_t n) const {
+    if (first + n > count) {
+        throw std::runtime_error("CachedSource: slice out of range");
+    }
+    auto view = std::make_shared<CachedSource>(*this);
+    view->rows += first * row_size;
+    view->labels += first;
+    view->count = n;
+    return view;
+}
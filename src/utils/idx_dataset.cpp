@@ -0,0 +1,109 @@
+#include "utils/idx_dataset.hpp"
+
+
+namespace {
+    uint32_t read_big_endian(const unsigned char* bytes) {
+        return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+    }
+}
+
+std::vector<uint32_t> get_idx_dimension(const MappedFile& file) {
+    // magic number ==> first 2 bytes 00, third byte indicate the type of data and the fourth byte indicate the number of dimensions
+    // size in dimension 0 
+    // ..... 
+    // size in dimension N 
+    // data
+    const unsigned char* bytes = file.data();
+    if (file.size() < 4 || bytes[0] != 0 || bytes[1] != 0) {
+        throw std::runtime_error("IDX: bad magic number");
+    }
+    if (bytes[2] != 0x08) {
+        throw std::runtime_error("IDX: only unsigned byte data is supported");
+    }
+
+    std::size_t n_dim = bytes[3];
+    if (n_dim == 0 || file.size() < idx_data_offset(n_dim)) {
+        throw std::runtime_error("IDX: truncated header");
+    }
+
+    std::vector<uint32_t> dimensions;
+    uint64_t payload = 1;
+    for (std::size_t i = 0; i < n_dim; ++i) {
+        dimensions.push_back(read_big_endian(bytes + 4 + 4 * i));
+        payload *= dimensions.back();
+    }
+    if (payload != file.size() - idx_data_offset(n_dim)) {
+        throw std::runtime_error("IDX: header dimensions do not match the file size");
+    }
+    return dimensions;
+}
+
+void idx_to_float(const unsigned char* __restrict pixels, float* __restrict out, std::size_t n) {
+    const float scale = 1.0f / 255.0f;
+    for (std::size_t i = 0; i < n; i++) {
+        out[i] = pixels[i] * scale;
+    }
+}
+
+IdxSource::IdxSource(const std::string& images_path, const std::string& labels_path)
+    : image_file(std::make_shared<MappedFile>(images_path)),
+      label_file(std::make_shared<MappedFile>(labels_path))
+{
+    auto image_dims = get_idx_dimension(*image_file);
+    if (image_dims.size() != 3) {
+        throw std::runtime_error("IDX: expected 3 dimensions for images in " + images_path);
+    }
+    auto label_dims = get_idx_dimension(*label_file);
+    if (label_dims.size() != 1) {
+        throw std::runtime_error("IDX: expected 1 dimension for labels in " + labels_path);
+    }
+    if (label_dims[0] != image_dims[0]) {
+        throw std::runtime_error("IDX: " + images_path + " and " + labels_path + " hold a different number of samples");
+    }
+
+    count = image_dims[0];
+    row_size = static_cast<std::size_t>(image_dims[1]) * image_dims[2];
+    shape = {image_dims[1], image_dims[2], 1};
+    pixels = image_file->data() + idx_data_offset(3);
+    labels = label_file->data() + idx_data_offset(1);
+
+    // one pass over the labels (one byte per sample) to number the classes
+    std::array<bool, 256> present{};
+    for (std::size_t i = 0; i < count; i++) {
+        present[labels[i]] = true;
+    }
+    for (std::size_t value = 0; value < present.size(); value++) {
+        if (present[value]) {
+            label_map[value] = static_cast<float>(classes++);
+        }
+    }
+}
+
+void IdxSource::load_rows(std::size_t first, std::size_t n, float* x, float* y) const {
+    idx_to_float(pixels + first * row_size, x, n * row_size);
+    for (std::size_t i = 0; i < n; i++) {
+        y[i] = label_map[labels[first + i]];
+    }
+}
+
+void IdxSource::gather(const std::size_t* indices, std::size_t n, float* x, float* y) const {
+    constexpr std::size_t lookahead = 4;
+    for (std::size_t i = 0; i < n; i++) {
+        if (i + lookahead < n) {
+            __builtin_prefetch(pixels + indices[i + lookahead] * row_size);
+        }
+        idx_to_float(pixels + indices[i] * row_size, x + i * row_size, row_size);
+        y[i] = label_map[labels[indices[i]]];
+    }
+}
+
+std::shared_ptr<IdxSource> IdxSource::slice(std::size_t first, std::size_t n) const {
+    if (first + n > count) {
+        throw std::runtime_error("IdxSource: slice out of range");
+    }
+    auto view = std::make_shared<IdxSource>(*this);
+    view->pixels += first * row_size;
+    view->labels += first;
+    view->count = n;
+    return view;
+}
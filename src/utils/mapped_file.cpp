@@ -0,0 +1,43 @@
+#include "utils/mapped_file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+MappedFile::MappedFile(const std::string& path, bool copy_on_write) : writable(copy_on_write) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Unable to map empty or unreadable file " + path);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+
+    // the mapping keeps its own reference to the file
+    int protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* mapping = mmap(nullptr, length, protection, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Unable to map " + path + ": " + std::strerror(errno));
+    }
+    bytes = static_cast<unsigned char*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    munmap(bytes, length);
+}
+
+unsigned char* MappedFile::mutable_data() {
+    if (!writable) {
+        throw std::runtime_error("MappedFile: the mapping is read-only.");
+    }
+    return bytes;
+}
@@ -0,0 +1,158 @@
+#include "utils/prefetcher.hpp"
+#include <chrono>
+#include <sys/mman.h>
+
+
+namespace {
+    bool lock_pages(Matrix& matrix) {
+        return mlock(matrix.data(), matrix.size() * sizeof(float)) == 0;
+    }
+
+    void unlock_pages(Matrix& matrix) {
+        munlock(matrix.data(), matrix.size() * sizeof(float));
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+Prefetcher::Prefetcher(const Dataloader& dataloader, const std::vector<std::size_t>& shard_sizes, std::size_t depth,
+                       unsigned int first_epoch)
+    : dataloader(dataloader), slots(depth), first_epoch(first_epoch)
+{
+    if (depth == 0) {
+        throw std::runtime_error("Prefetcher: depth must be >= 1.");
+    }
+
+    std::size_t rows = 0;
+    for (auto size : shard_sizes) {
+        rows += size;
+    }
+    if (rows != dataloader.batch_size) {
+        throw std::runtime_error("Prefetcher: shards must cover exactly one batch.");
+    }
+
+    pinned_memory = true;
+    for (auto& slot : slots) {
+        slot.shards.resize(shard_sizes.size());
+        for (std::size_t k = 0; k < shard_sizes.size(); k++) {
+            slot.shards[k].x.resize({shard_sizes[k], dataloader.sparse() ? 0 : dataloader.n_features});
+            slot.shards[k].y.resize({shard_sizes[k], 1});
+            pinned_memory = lock_pages(slot.shards[k].x) && lock_pages(slot.shards[k].y) && pinned_memory;
+        }
+    }
+
+    producer = std::thread(&Prefetcher::produce, this);
+}
+
+Prefetcher::~Prefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    free_cv.notify_all();
+    producer.join();
+
+    for (auto& slot : slots) {
+        for (auto& shard : slot.shards) {
+            unlock_pages(shard.x);
+            unlock_pages(shard.y);
+        }
+    }
+}
+
+const Prefetcher::Slot& Prefetcher::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (filled == 0) {
+        auto start = std::chrono::steady_clock::now();
+        ready_cv.wait(lock, [this] { return filled > 0 || error; });
+        stats.stall_s += seconds_since(start);
+        stats.stalls++;
+    }
+    if (filled == 0) {
+        std::rethrow_exception(error);
+    }
+    return slots[head];
+}
+
+void Prefetcher::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        head = (head + 1) % slots.size();
+        filled--;
+        stats.batches++;
+    }
+    free_cv.notify_one();
+}
+
+Prefetcher::Stats Prefetcher::take_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    stats = Stats();
+    return result;
+}
+
+void Prefetcher::produce() {
+    // an exception would terminate the process from this thread: the consumer rethrows it
+    try {
+        run_producer();
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+        ready_cv.notify_one();
+    }
+}
+
+void Prefetcher::run_producer() {
+    std::size_t tail = 0;
+    unsigned int epoch = first_epoch;
+    unsigned int batch = 0;
+    std::vector<std::size_t> order;
+    dataloader.epoch_indices(epoch, order);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (filled == slots.size() && !stopping) {
+                auto start = std::chrono::steady_clock::now();
+                free_cv.wait(lock, [this] { return stopping || filled < slots.size(); });
+                stats.backpressure_s += seconds_since(start);
+            }
+            if (stopping) {
+                return;
+            }
+        }
+
+        // the consumer never touches a slot that is not filled, so no lock while copying
+        fill(slots[tail], order, epoch, batch);
+        tail = (tail + 1) % slots.size();
+        if (++batch == dataloader.n_batches) {
+            batch = 0;
+            dataloader.epoch_indices(++epoch, order);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            filled++;
+        }
+        ready_cv.notify_one();
+    }
+}
+
+void Prefetcher::fill(Slot& slot, const std::vector<std::size_t>& order, unsigned int epoch, unsigned int batch) {
+    const std::size_t* indices = order.data() + static_cast<std::size_t>(batch) * dataloader.batch_size;
+    for (auto& shard : slot.shards) {
+        std::size_t rows = shard.y.shape()[0];
+        if (dataloader.sparse()) {
+            dataloader.gather_sparse(indices, rows, shard.x_sparse, shard.y);
+        } else {
+            dataloader.gather(indices, rows, shard.x, shard.y);
+        }
+        indices += rows;
+    }
+    slot.epoch = epoch;
+    slot.batch = batch;
+}
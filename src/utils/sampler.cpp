@@ -0,0 +1,116 @@
+#include "utils/sampler.hpp"
+#include "common.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+
+namespace {
+    uint64_t resolve_seed(uint64_t seed) {
+        return seed != 0 ? seed : xt::random::get_default_random_engine()();
+    }
+
+    std::mt19937_64 epoch_engine(uint64_t seed, unsigned int epoch) {
+        std::seed_seq sequence{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), epoch};
+        return std::mt19937_64(sequence);
+    }
+}
+
+void SequentialSampler::epoch_indices(unsigned int, std::vector<std::size_t>& indices) const {
+    indices.resize(n);
+    std::iota(indices.begin(), indices.end(), 0);
+}
+
+RandomSampler::RandomSampler(std::size_t n, uint64_t seed) : n(n), seed(resolve_seed(seed)) {}
+
+void RandomSampler::epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const {
+    indices.resize(n);
+    std::iota(indices.begin(), indices.end(), 0);
+    auto engine = epoch_engine(seed, epoch);
+    std::shuffle(indices.begin(), indices.end(), engine);
+}
+
+StratifiedSampler::StratifiedSampler(const std::vector<std::size_t>& labels, uint64_t seed)
+    : n(labels.size()), seed(resolve_seed(seed))
+{
+    for (std::size_t i = 0; i < labels.size(); i++) {
+        if (labels[i] >= classes.size()) {
+            classes.resize(labels[i] + 1);
+        }
+        classes[labels[i]].push_back(i);
+    }
+}
+
+void StratifiedSampler::epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const {
+    auto engine = epoch_engine(seed, epoch);
+    std::uniform_real_distribution<double> jitter(0.0, 1.0);
+
+    // the k-th of m samples of a class lands at position ~ (k + u) / m of the epoch,
+    // so each class is spread evenly and batches keep the class proportions
+    std::vector<std::pair<double, std::size_t>> keyed;
+    keyed.reserve(n);
+    std::vector<std::size_t> members;
+    for (const auto& class_indices : classes) {
+        members = class_indices;
+        std::shuffle(members.begin(), members.end(), engine);
+        double m = static_cast<double>(members.size());
+        for (std::size_t k = 0; k < members.size(); k++) {
+            keyed.emplace_back((k + jitter(engine)) / m, members[k]);
+        }
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    indices.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        indices[i] = keyed[i].second;
+    }
+}
+
+WeightedSampler::WeightedSampler(std::vector<double> weights, std::size_t n_samples, uint64_t seed)
+    : weights(std::move(weights)), n_samples(n_samples), seed(resolve_seed(seed))
+{
+    if (this->weights.empty() || std::accumulate(this->weights.begin(), this->weights.end(), 0.0) <= 0.0) {
+        throw std::runtime_error("WeightedSampler: weights must have a positive sum.");
+    }
+}
+
+std::vector<double> WeightedSampler::class_balanced(const std::vector<std::size_t>& labels) {
+    std::vector<std::size_t> counts;
+    for (auto label : labels) {
+        if (label >= counts.size()) {
+            counts.resize(label + 1, 0);
+        }
+        counts[label]++;
+    }
+
+    std::vector<double> weights(labels.size());
+    for (std::size_t i = 0; i < labels.size(); i++) {
+        weights[i] = 1.0 / counts[labels[i]];
+    }
+    return weights;
+}
+
+void WeightedSampler::epoch_indices(unsigned int epoch, std::vector<std::size_t>& indices) const {
+    auto engine = epoch_engine(seed, epoch);
+    std::discrete_distribution<std::size_t> distribution(weights.begin(), weights.end());
+    indices.resize(n_samples);
+    for (auto& index : indices) {
+        index = distribution(engine);
+    }
+}
+
+std::shared_ptr<Sampler> make_sampler(const nlohmann::json& config, const std::vector<std::size_t>& labels) {
+    std::string name = config.value("sampler", "random");
+    uint64_t seed = config.value("sampler_seed", uint64_t(0));
+
+    if (name == "sequential") {
+        return std::make_shared<SequentialSampler>(labels.size());
+    } else if (name == "random") {
+        return std::make_shared<RandomSampler>(labels.size(), seed);
+    } else if (name == "stratified") {
+        return std::make_shared<StratifiedSampler>(labels, seed);
+    } else if (name == "weighted") {
+        return std::make_shared<WeightedSampler>(WeightedSampler::class_balanced(labels), labels.size(), seed);
+    }
+    throw std::runtime_error("Unknown sampler: " + name);
+}
@@ -0,0 +1,80 @@
+#include "utils/thread_pool.hpp"
+
+
+WorkerPool::WorkerPool(std::size_t n_workers) {
+    for (std::size_t i = 1; i < n_workers; i++) {
+        threads.emplace_back(&WorkerPool::worker_loop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::dispatch(Trampoline trampoline, void* task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->trampoline = trampoline;
+        this->task = task;
+        pending = threads.size();
+        error = nullptr;
+        generation++;
+    }
+    start_cv.notify_all();
+
+    std::exception_ptr main_error;
+    try {
+        trampoline(task, 0);
+    } catch (...) {
+        main_error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+    if (main_error) {
+        std::rethrow_exception(main_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::worker_loop(std::size_t index) {
+    std::size_t seen = 0;
+    while (true) {
+        Trampoline current_trampoline;
+        void* current_task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            current_trampoline = trampoline;
+            current_task = task;
+        }
+
+        std::exception_ptr task_error;
+        try {
+            current_trampoline(current_task, index);
+        } catch (...) {
+            task_error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (task_error && !error) {
+            error = task_error;
+        }
+        if (--pending == 0) {
+            done_cv.notify_one();
+        }
+    }
+}
\ No newline at end of file
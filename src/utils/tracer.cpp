@@ -0,0 +1,146 @@
+#include "utils/tracer.hpp"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace {
+    const char* phase_names[] = {"forward", "backward", "loss", "data", "reduce", "optimizer"};
+    constexpr std::size_t n_global_phases = 4;
+
+    bool per_layer(Tracer::Phase phase) {
+        return phase == Tracer::Phase::Forward || phase == Tracer::Phase::Backward;
+    }
+
+    // per-layer operations first, then one slot per global phase
+    std::size_t totals_index(std::size_t n_layers, uint32_t layer, Tracer::Phase phase) {
+        if (per_layer(phase)) {
+            return 2 * layer + static_cast<std::size_t>(phase);
+        }
+        return 2 * n_layers + static_cast<std::size_t>(phase) - static_cast<std::size_t>(Tracer::Phase::Loss);
+    }
+}
+
+void Tracer::Lane::record(uint32_t layer, Phase phase, int64_t start_ns, int64_t end_ns, double flops, double bytes) {
+    Totals& total = totals[totals_index(n_layers, layer, phase)];
+    total.calls++;
+    total.ns += end_ns - start_ns;
+    total.flops += flops;
+    total.bytes += bytes;
+
+    if (events.size() < max_events) {
+        events.push_back({start_ns, end_ns - start_ns, flops, bytes, layer, phase});
+    } else {
+        dropped++;
+    }
+}
+
+void Tracer::configure(std::vector<std::string> names, std::vector<std::size_t> parameters, std::size_t n_lanes) {
+    layer_names = std::move(names);
+    layer_parameters = std::move(parameters);
+    lanes.assign(n_lanes, Lane());
+    for (auto& lane : lanes) {
+        lane.n_layers = layer_names.size();
+        lane.totals.resize(2 * layer_names.size() + n_global_phases);
+        lane.max_events = max_events / n_lanes;
+    }
+    origin_ns = now_ns();
+}
+
+TraceSummary Tracer::take_summary() {
+    TraceSummary summary;
+    if (lanes.empty()) {
+        return summary;
+    }
+
+    std::size_t n_layers = layer_names.size();
+    for (std::size_t index = 0; index < lanes[0].totals.size(); index++) {
+        Lane::Totals total;
+        for (auto& lane : lanes) {
+            total.calls += lane.totals[index].calls;
+            total.ns += lane.totals[index].ns;
+            total.flops += lane.totals[index].flops;
+            total.bytes += lane.totals[index].bytes;
+            lane.totals[index] = Lane::Totals();
+        }
+        if (total.calls == 0) {
+            continue;
+        }
+
+        TraceRow row;
+        if (index < 2 * n_layers) {
+            row.name = layer_names[index / 2];
+            row.phase = phase_names[index % 2];
+        } else {
+            row.name = "-";
+            row.phase = phase_names[static_cast<std::size_t>(Phase::Loss) + index - 2 * n_layers];
+        }
+        row.calls = total.calls;
+        row.total_ms = total.ns / 1e6;
+        if (total.ns > 0) {
+            // per nanosecond is per second in giga
+            row.gflops = total.flops / total.ns;
+            row.gbytes_per_s = total.bytes / total.ns;
+        }
+        summary.rows.push_back(std::move(row));
+    }
+    return summary;
+}
+
+void TraceSummary::print(std::ostream& out) const {
+    auto flags = out.flags();
+    out << std::left << std::setw(22) << "operation" << std::setw(11) << "phase" << std::right
+        << std::setw(8) << "calls" << std::setw(12) << "total ms" << std::setw(10) << "GFLOP/s"
+        << std::setw(10) << "GB/s" << std::endl;
+    out << std::fixed << std::setprecision(2);
+    for (const auto& row : rows) {
+        out << std::left << std::setw(22) << row.name << std::setw(11) << row.phase << std::right
+            << std::setw(8) << row.calls << std::setw(12) << row.total_ms << std::setw(10) << row.gflops
+            << std::setw(10) << row.gbytes_per_s << std::endl;
+    }
+    out.flags(flags);
+}
+
+std::string Tracer::event_name(uint32_t layer, Phase phase) const {
+    if (per_layer(phase)) {
+        return layer_names[layer] + " " + phase_names[static_cast<std::size_t>(phase)];
+    }
+    return phase_names[static_cast<std::size_t>(phase)];
+}
+
+void Tracer::write_chrome_trace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Tracer: unable to write " + path);
+    }
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    std::size_t dropped = 0;
+    out << std::fixed << std::setprecision(3);
+    for (std::size_t tid = 0; tid < lanes.size(); tid++) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << tid
+            << ", \"args\": {\"name\": \"worker " << tid << "\"}}";
+        first = false;
+
+        for (const auto& event : lanes[tid].events) {
+            // trace_event timestamps are in microseconds
+            out << ",\n{\"name\": \"" << event_name(event.layer, event.phase) << "\", \"cat\": \""
+                << phase_names[static_cast<std::size_t>(event.phase)] << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << tid
+                << ", \"ts\": " << (event.start_ns - origin_ns) / 1e3 << ", \"dur\": " << event.duration_ns / 1e3;
+            if (event.flops > 0.0 || event.bytes > 0.0) {
+                double gflops = event.duration_ns > 0 ? event.flops / event.duration_ns : 0.0;
+                out << ", \"args\": {\"flops\": " << event.flops << ", \"bytes\": " << event.bytes
+                    << ", \"gflops\": " << gflops << "}";
+            }
+            out << "}";
+        }
+        dropped += lanes[tid].dropped;
+    }
+    out << "\n]}\n";
+
+    if (dropped > 0) {
+        std::cerr << "Tracer: " << dropped << " events past max_events were left out of " << path << std::endl;
+    }
+}
@@ -0,0 +1,65 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "model.hpp"
+#include "utils/data_config.hpp"
+
+// Trains the model described by config.json, quantizes it to int8 with
+// ranges calibrated on the training split, and reports the accuracy delta on
+// the validation split with the weight size and inference throughput of both.
+
+double samples_per_second(Model& model, const Dataloader& dataloader) {
+    model.evaluate(dataloader);
+    int passes = 0;
+    double elapsed = 0.0;
+    auto start = std::chrono::high_resolution_clock::now();
+    do {
+        model.evaluate(dataloader);
+        passes++;
+        elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    } while (elapsed < 0.5);
+    return static_cast<double>(passes) * dataloader.n_batches * dataloader.batch_size / elapsed;
+}
+
+int main(int argc, char** argv) {
+    auto config = load_json(argc > 1 ? argv[1] : "../config.json");
+    if (config.is_null()) {
+        std::cerr << "Failed to load config.json" << std::endl;
+        return 1;
+    }
+    xt::random::seed(config.value("seed", 0));
+
+    auto splits = load_data_splits(config);
+    Model model(std::make_unique<loss::CrossEntropy>(), config.value("learning_rate", 1e-4),
+                config.value("weight_decay", 1e-4), config.value("epochs", 1000));
+    model.setOptimizer(optim::make_optimizer(config));
+    model.setThreads(config.value("threads", 1));
+    model.addLayer(std::make_unique<DenseLayer>(splits.train->n_features, 16));
+    model.addLayer(std::make_unique<activation::ReLU>());
+    model.addLayer(std::make_unique<DenseLayer>(16, splits.n_classes));
+    model.addLayer(std::make_unique<activation::Softmax>());
+    model.train(*splits.train, *splits.val);
+
+    auto [float_loss, float_accuracy] = model.evaluate(*splits.val);
+    double float_rate = samples_per_second(model, *splits.val);
+
+    auto report = model.quantize(*splits.train, config.value("calibration_batches", 16u));
+    auto [int8_loss, int8_accuracy] = model.evaluate(*splits.val);
+    double int8_rate = samples_per_second(model, *splits.val);
+
+    std::cout << "int8 gemm: " << kernels::int8_isa_name(kernels::detected_int8_isa()) << std::endl;
+    std::cout << std::left << std::setw(8) << "" << std::setw(14) << "weights (B)" << std::setw(12) << "val loss"
+              << std::setw(14) << "val accuracy" << std::setw(12) << "samples/s" << std::endl;
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << std::setw(8) << "fp32" << std::setw(14) << report.float_weight_bytes << std::setw(12) << float_loss
+              << std::setw(14) << float_accuracy << std::setw(12) << std::setprecision(0) << float_rate << std::endl;
+    std::cout << std::setprecision(4);
+    std::cout << std::setw(8) << "int8" << std::setw(14) << report.int8_weight_bytes << std::setw(12) << int8_loss
+              << std::setw(14) << int8_accuracy << std::setw(12) << std::setprecision(0) << int8_rate << std::endl;
+    std::cout << std::setprecision(4) << "accuracy delta: " << int8_accuracy - float_accuracy
+              << ", weights " << std::setprecision(2)
+              << static_cast<double>(report.float_weight_bytes) / report.int8_weight_bytes << "x smaller" << std::endl;
+    return 0;
+}
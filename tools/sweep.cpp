@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "model.hpp"
+#include "utils/data_config.hpp"
+
+// Hyperparameter sweep: loads the dataset of config.json once, then trains
+// one single-threaded Model per trial, as many at a time as there are cores,
+// each pool thread pinned to its own core. Trials stop early on a stalled
+// validation loss or when they fall behind the median of the other trials,
+// and every finished trial is appended to a JSONL file.
+//
+//   sweep [config.json] [sweep.json]
+//
+// sweep.json: "search" (grid or random), "trials" (random), "seed",
+// "parallel_trials" (0: every core), "patience", "prune_after_epochs",
+// "output", and "parameters": config keys mapped to a list of values, or
+// for random search to {"min", "max", "log"}. A trial's config is
+// config.json with its parameter values written over it.
+
+// The OpenBLAS call when the binary is linked against OpenBLAS, null otherwise.
+extern "C" void openblas_set_num_threads(int threads) __attribute__((weak));
+
+namespace {
+    std::vector<nlohmann::json> grid_trials(const nlohmann::json& parameters) {
+        std::vector<nlohmann::json> trials{nlohmann::json::object()};
+        for (const auto& [key, values] : parameters.items()) {
+            if (!values.is_array() || values.empty()) {
+                throw std::runtime_error("sweep: grid parameter \"" + key + "\" must be a non-empty list.");
+            }
+            std::vector<nlohmann::json> expanded;
+            for (const auto& trial : trials) {
+                for (const auto& value : values) {
+                    expanded.push_back(trial);
+                    expanded.back()[key] = value;
+                }
+            }
+            trials = std::move(expanded);
+        }
+        return trials;
+    }
+
+    std::vector<nlohmann::json> random_trials(const nlohmann::json& parameters, std::size_t count, uint64_t seed) {
+        std::mt19937_64 engine(seed);
+        std::vector<nlohmann::json> trials(count, nlohmann::json::object());
+        for (auto& trial : trials) {
+            for (const auto& [key, values] : parameters.items()) {
+                if (values.is_array()) {
+                    std::uniform_int_distribution<std::size_t> pick(0, values.size() - 1);
+                    trial[key] = values[pick(engine)];
+                    continue;
+                }
+                double min = values.at("min");
+                double max = values.at("max");
+                if (values.value("log", false)) {
+                    std::uniform_real_distribution<double> exponent(std::log(min), std::log(max));
+                    trial[key] = std::exp(exponent(engine));
+                } else {
+                    trial[key] = std::uniform_real_distribution<double>(min, max)(engine);
+                }
+            }
+        }
+        return trials;
+    }
+
+    // Stops a trial whose validation loss is above the median of every
+    // trial that reached the same epoch, once `after_epochs` are done.
+    class MedianPruner {
+        std::mutex mutex;
+        std::vector<std::vector<float>> losses;
+        int after_epochs;
+        std::size_t min_trials = 3;
+
+    public:
+        explicit MedianPruner(int after_epochs) : after_epochs(after_epochs) {}
+
+        bool report(int epoch, float val_loss) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (losses.size() <= static_cast<std::size_t>(epoch)) {
+                losses.resize(epoch + 1);
+            }
+            auto& reached = losses[epoch];
+            reached.push_back(val_loss);
+            if (after_epochs <= 0 || epoch + 1 < after_epochs || reached.size() < min_trials) {
+                return false;
+            }
+            std::vector<float> sorted = reached;
+            std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+            return val_loss > sorted[sorted.size() / 2];
+        }
+    };
+
+    // Pins the calling thread to the index-th CPU it may run on.
+    int pin_to_cpu(std::size_t index) {
+#ifdef __linux__
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+            return -1;
+        }
+        std::size_t target = index % CPU_COUNT(&allowed);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+                cpu_set_t single;
+                CPU_ZERO(&single);
+                CPU_SET(cpu, &single);
+                return pthread_setaffinity_np(pthread_self(), sizeof(single), &single) == 0 ? cpu : -1;
+            }
+        }
+#endif
+        return -1;
+    }
+
+    std::size_t available_cpus() {
+#ifdef __linux__
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0) {
+            return CPU_COUNT(&allowed);
+        }
+#endif
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void add_layers(Model& model, const nlohmann::json& config, const DataSplits& splits) {
+        if (config.value("model", "mlp") == "cnn") {
+            if (splits.image_shape.size() == 0) {
+                throw std::runtime_error("sweep: the cnn model needs an image dataset.");
+            }
+            auto conv1 = std::make_unique<Conv2DLayer>(splits.image_shape, 8, 3);
+            auto pool1 = std::make_unique<MaxPool2D>(conv1->output_image(), 2);
+            auto conv2 = std::make_unique<Conv2DLayer>(pool1->output_image(), 16, 3);
+            auto pool2 = std::make_unique<MaxPool2D>(conv2->output_image(), 2);
+            ImageShape features = pool2->output_image();
+            model.addLayer(std::move(conv1));
+            model.addLayer(std::make_unique<activation::ReLU>());
+            model.addLayer(std::move(pool1));
+            model.addLayer(std::move(conv2));
+            model.addLayer(std::make_unique<activation::ReLU>());
+            model.addLayer(std::move(pool2));
+            model.addLayer(std::make_unique<Flatten>(features));
+            model.addLayer(std::make_unique<DenseLayer>(features.size(), splits.n_classes));
+        } else {
+            std::size_t hidden = config.value("hidden", 16);
+            model.addLayer(std::make_unique<DenseLayer>(splits.train->n_features, hidden));
+            model.addLayer(std::make_unique<activation::ReLU>());
+            model.addLayer(std::make_unique<DenseLayer>(hidden, splits.n_classes));
+        }
+        model.addLayer(std::make_unique<activation::Softmax>());
+    }
+}
+
+int main(int argc, char** argv) {
+    auto config = load_json(argc > 1 ? argv[1] : "../config.json");
+    auto spec = load_json(argc > 2 ? argv[2] : "../sweep.json");
+    if (config.is_null() || spec.is_null()) {
+        std::cerr << "Failed to load config.json or sweep.json" << std::endl;
+        return 1;
+    }
+
+    // trials fill the cores, a multi-threaded BLAS would only oversubscribe them
+    if (openblas_set_num_threads) {
+        openblas_set_num_threads(1);
+    } else {
+        std::cerr << "sweep: not linked against OpenBLAS, set the BLAS library to one thread" << std::endl;
+    }
+
+    xt::random::seed(spec.value("seed", 0));
+    auto splits = load_data_splits(config);
+
+    const auto& parameters = spec.at("parameters");
+    std::vector<nlohmann::json> trials = spec.value("search", "grid") == "random"
+        ? random_trials(parameters, spec.value("trials", 16), spec.value("seed", 0))
+        : grid_trials(parameters);
+    if (trials.empty()) {
+        std::cerr << "sweep: no trials to run" << std::endl;
+        return 1;
+    }
+    std::size_t parallel = spec.value("parallel_trials", 0);
+    parallel = std::min(parallel == 0 ? available_cpus() : parallel, trials.size());
+    int patience = spec.value("patience", 0);
+    MedianPruner pruner(spec.value("prune_after_epochs", 0));
+
+    std::string output_path = spec.value("output", "sweep.jsonl");
+    std::ofstream output(output_path, std::ios::app);
+    if (!output) {
+        std::cerr << "Failed to open " << output_path << std::endl;
+        return 1;
+    }
+    std::cerr << "sweep: " << trials.size() << " trials, " << parallel << " at a time, results in " << output_path << std::endl;
+
+    // xt::random's default engine is global: seeding and layer initialization take turns
+    std::mutex init_mutex;
+    std::mutex output_mutex;
+    std::atomic<std::size_t> next_trial = 0;
+    nlohmann::json best;
+
+    WorkerPool pool(parallel);
+    pool.run([&](std::size_t w) {
+        int cpu = pin_to_cpu(w);
+        for (std::size_t t = next_trial++; t < trials.size(); t = next_trial++) {
+            nlohmann::json trial_config = config;
+            trial_config.update(trials[t]);
+
+            nlohmann::json result = {{"trial", t}, {"params", trials[t]}, {"cpu", cpu}};
+            auto start = std::chrono::high_resolution_clock::now();
+            try {
+                // batches and model are per trial, the samples are shared
+                Dataloader train_dataloader = splits.train->rebatched(trial_config.value("train_batch_size", 4));
+                float best_val_loss = std::numeric_limits<float>::infinity();
+                int since_best = 0;
+                std::string stopped = "completed";
+                EpochResult last{};
+
+                std::unique_ptr<Model> model;
+                auto on_epoch_end = [&](const EpochResult& epoch_result) {
+                    last = epoch_result;
+                    if (epoch_result.val_loss < best_val_loss) {
+                        best_val_loss = epoch_result.val_loss;
+                        since_best = 0;
+                    } else if (patience > 0 && ++since_best >= patience) {
+                        stopped = "patience";
+                        model->stopTraining();
+                    }
+                    if (pruner.report(epoch_result.epoch, epoch_result.val_loss) && stopped == "completed") {
+                        stopped = "pruned";
+                        model->stopTraining();
+                    }
+                };
+                {
+                    std::lock_guard<std::mutex> lock(init_mutex);
+                    xt::random::seed(spec.value("seed", 0) + t);
+                    model = std::make_unique<Model>(std::make_unique<loss::CrossEntropy>(),
+                                                    trial_config.value("learning_rate", 1e-4),
+                                                    trial_config.value("weight_decay", 1e-4),
+                                                    spec.value("epochs", trial_config.value("epochs", 1000)), on_epoch_end);
+                    add_layers(*model, trial_config, splits);
+                }
+                model->setOptimizer(optim::make_optimizer(trial_config));
+                model->setProgress(false);
+                model->setGradAccumulation(trial_config.value("grad_accumulation_steps", 1));
+                model->setMixedPrecision(trial_config.value("mixed_precision", false));
+                model->train(train_dataloader, *splits.val);
+
+                result["epochs"] = last.epoch + 1;
+                result["stopped"] = stopped;
+                result["train_loss"] = last.train_loss;
+                result["val_loss"] = last.val_loss;
+                result["val_accuracy"] = last.val_accuracy;
+                result["best_val_loss"] = best_val_loss;
+            } catch (const std::exception& error) {
+                result["stopped"] = "error";
+                result["error"] = error.what();
+            }
+            result["seconds"] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            output << result.dump() << std::endl;
+            if (result.contains("best_val_loss") && (best.is_null() || result["best_val_loss"] < best["best_val_loss"])) {
+                best = result;
+            }
+        }
+    });
+
+    if (!best.is_null()) {
+        std::cout << "best trial " << best["trial"] << ": " << best["params"].dump()
+                  << ", best val loss " << best["best_val_loss"] << ", val accuracy " << best["val_accuracy"] << std::endl;
+    }
+    return 0;
+}